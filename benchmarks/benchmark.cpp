@@ -0,0 +1,260 @@
+#include "json.h"
+#include "json_builder.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "network_generator.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+  struct BenchmarkOptions {
+    int stops = 200;
+    int buses = 40;
+    std::string route_length = "uniform:5:20"s;
+    std::string topology = "grid"s;
+    int iterations = 20;
+    int queries = 1000;
+    unsigned seed = 42;
+    std::set <std::string> cases;
+  };
+
+  struct CaseResult {
+    std::string name;
+    std::vector <double> samples_us;
+    size_t items_per_sample = 1;
+  };
+
+  double Percentile(std::vector <double> samples, double fraction) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    const size_t index = std::min(samples.size() - 1, static_cast <size_t> (fraction * samples.size()));
+    return samples[index];
+  }
+
+  template <typename Function>
+  double MeasureUs(Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration <double, std::micro> (finish - start).count();
+  }
+
+  std::string StopName(int index) {
+    return "S"s + std::to_string(index);
+  }
+
+  std::string BusName(int index) {
+    return "B"s + std::to_string(index);
+  }
+
+  std::string MakeInput(const BenchmarkOptions& options) {
+    generator::NetworkOptions network;
+    network.stops = options.stops;
+    network.buses = options.buses;
+    network.route_length = generator::ParseRouteLength(options.route_length);
+    network.topology = generator::ParseTopology(options.topology);
+    network.seed = options.seed;
+    network.requests.count = 1;
+    std::ostringstream out;
+    generator::GenerateNetwork(network, out);
+    return out.str();
+  }
+
+  void PrintResults(const BenchmarkOptions& options, const std::vector <CaseResult>& results) {
+    json::Array cases;
+    for (const auto& result : results) {
+      double total_us = 0.0;
+      for (double sample : result.samples_us) total_us += sample;
+      const double items = static_cast <double> (result.items_per_sample * result.samples_us.size());
+      cases.push_back(json::Builder{}.StartDict()
+        .Key("name"s).Value(result.name)
+        .Key("samples"s).Value(static_cast <int> (result.samples_us.size()))
+        .Key("items_per_sample"s).Value(static_cast <int> (result.items_per_sample))
+        .Key("total_ms"s).Value(total_us / 1000.0)
+        .Key("throughput_per_s"s).Value(total_us > 0 ? items / total_us * 1e6 : 0.0)
+        .Key("p50_us"s).Value(Percentile(result.samples_us, 0.50))
+        .Key("p90_us"s).Value(Percentile(result.samples_us, 0.90))
+        .Key("p99_us"s).Value(Percentile(result.samples_us, 0.99))
+        .Key("max_us"s).Value(Percentile(result.samples_us, 1.0))
+        .EndDict().Build());
+    }
+    json::Node report = json::Builder{}.StartDict()
+      .Key("config"s).StartDict()
+        .Key("stops"s).Value(options.stops)
+        .Key("buses"s).Value(options.buses)
+        .Key("route_length"s).Value(options.route_length)
+        .Key("topology"s).Value(options.topology)
+        .Key("iterations"s).Value(options.iterations)
+        .Key("queries"s).Value(options.queries)
+        .Key("seed"s).Value(static_cast <int> (options.seed))
+        .EndDict()
+      .Key("cases"s).Value(cases)
+      .EndDict().Build();
+    json::Print(json::Document{report}, std::cout);
+    std::cout << std::endl;
+  }
+
+  BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const auto eq = arg.find('=');
+      const std::string key = arg.substr(0, eq);
+      const std::string value = eq == std::string::npos ? ""s : arg.substr(eq + 1);
+      if (key == "--stops") options.stops = std::stoi(value);
+      else if (key == "--buses") options.buses = std::stoi(value);
+      else if (key == "--route-length") options.route_length = value;
+      else if (key == "--topology") options.topology = value;
+      else if (key == "--iterations") options.iterations = std::stoi(value);
+      else if (key == "--queries") options.queries = std::stoi(value);
+      else if (key == "--seed") options.seed = static_cast <unsigned> (std::stoul(value));
+      else if (key == "--case") options.cases.insert(value);
+      else {
+        std::cerr << "usage: benchmark [--stops=N] [--buses=N] [--route-length=SPEC] [--topology=NAME] [--iterations=N] "
+                     "[--queries=N] [--seed=N] [--case=NAME]..." << std::endl;
+        std::exit(1);
+      }
+    }
+    if (options.stops < 2 || options.buses < 1 || options.iterations < 1) {
+      std::cerr << "stops must be at least 2, buses and iterations at least 1" << std::endl;
+      std::exit(1);
+    }
+    try {
+      generator::ParseRouteLength(options.route_length);
+      generator::ParseTopology(options.topology);
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      std::exit(1);
+    }
+    return options;
+  }
+
+}
+
+int main(int argc, char* argv[]) {
+  const BenchmarkOptions options = ParseOptions(argc, argv);
+  auto enabled = [&options](const std::string& name) {
+    return options.cases.empty() || options.cases.count(name);
+  };
+
+  const std::string input = MakeInput(options);
+  std::vector <CaseResult> results;
+
+  if (enabled("json_load")) {
+    CaseResult result {"json_load", {}, 1};
+    for (int i = 0; i < options.iterations; ++i) {
+      std::istringstream in(input);
+      result.samples_us.push_back(MeasureUs([&in] {
+        json::Document document = json::Load(in);
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  if (enabled("parse_catalogue")) {
+    CaseResult result {"parse_catalogue", {}, 1};
+    for (int i = 0; i < options.iterations; ++i) {
+      std::istringstream in(input);
+      JSONReader reader(in);
+      transport::TransportCatalogue catalogue;
+      result.samples_us.push_back(MeasureUs([&reader, &catalogue] {
+        reader.ParseCatalogue(catalogue);
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  std::istringstream in(input);
+  JSONReader reader(in);
+  transport::TransportCatalogue catalogue;
+  reader.ParseCatalogue(catalogue);
+  const router::RoutingSettings routing_settings = reader.FillRoutingSettings(reader.GetRoutingSettings().AsMap());
+  const renderer::RenderSettings render_settings = reader.ParseRenderSettings();
+
+  if (enabled("router_build")) {
+    CaseResult result {"router_build", {}, 1};
+    for (int i = 0; i < options.iterations; ++i) {
+      result.samples_us.push_back(MeasureUs([&catalogue, &routing_settings] {
+        router::TransportRouter router{catalogue, routing_settings};
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  if (enabled("route_query")) {
+    router::RoutingSettings uncached = routing_settings;
+    uncached.route_cache_capacity = 0;
+    const router::TransportRouter router{catalogue, uncached};
+    std::mt19937 generator(options.seed);
+    std::uniform_int_distribution <int> any_stop(0, options.stops - 1);
+    CaseResult result {"route_query", {}, 1};
+    for (int i = 0; i < options.queries; ++i) {
+      transport::Stop* from = catalogue.FindStop(StopName(any_stop(generator)));
+      transport::Stop* to = catalogue.FindStop(StopName(any_stop(generator)));
+      result.samples_us.push_back(MeasureUs([&router, from, to] {
+        std::optional <router::RouteView> route = router.FindRoute(from, to);
+        if (route) {
+          volatile double total_time = route->GetTotalTime();
+          (void) total_time;
+        }
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  if (enabled("bus_stats")) {
+    CaseResult result {"bus_stats", {}, static_cast <size_t> (options.buses)};
+    for (int i = 0; i < options.iterations; ++i) {
+      result.samples_us.push_back(MeasureUs([&catalogue, &options] {
+        for (int bus = 0; bus < options.buses; ++bus) {
+          catalogue.GetBusStats(BusName(bus));
+        }
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  if (enabled("render_map")) {
+    CaseResult result {"render_map", {}, 1};
+    for (int i = 0; i < options.iterations; ++i) {
+      // A fresh renderer per sample so the fragment cache does not hide the
+      // cost of a cold render.
+      const renderer::MapRenderer map_renderer{render_settings};
+      result.samples_us.push_back(MeasureUs([&map_renderer, &catalogue] {
+        std::string map = map_renderer.RenderBusesMap(catalogue);
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  if (enabled("json_print")) {
+    std::istringstream document_in(input);
+    const json::Document document = json::Load(document_in);
+    CaseResult result {"json_print", {}, 1};
+    for (int i = 0; i < options.iterations; ++i) {
+      std::ostringstream out;
+      result.samples_us.push_back(MeasureUs([&document, &out] {
+        json::Print(document, out);
+      }));
+    }
+    results.push_back(std::move(result));
+  }
+
+  PrintResults(options, results);
+}
@@ -0,0 +1,136 @@
+#include "json_reader.h"
+#include "network_generator.h"
+#include "snapshot.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+// Publishes a snapshot with other wait and velocity settings for every engine
+// and weight type. Each route of the new snapshot has to take as long as the
+// same route from a router built from scratch with those settings, some routes
+// have to change, and a reader still holding the old snapshot has to keep
+// getting the old times.
+namespace {
+
+  const router::TimeSettings NEW_TIME_SETTINGS{20, 15.0};
+  const size_t CHECKED_STOPS = 60;
+
+  std::optional<double> GetTotalTime(const router::TransportRouter& router, const transport::Stop* from, const transport::Stop* to) {
+    if (const auto route = router.FindRoute(from, to)) {
+      return route->GetTotalTime();
+    }
+    return std::nullopt;
+  }
+
+  bool SameTime(std::optional<double> lhs, std::optional<double> rhs) {
+    return lhs.has_value() == rhs.has_value() && (!lhs || std::abs(*lhs - *rhs) < 1e-6);
+  }
+
+  // Empty if the published snapshot was re-customized and the old one left
+  // alone.
+  std::string Check(const std::string& document, router::RouteEngine engine, router::WeightType weight_type) {
+    std::istringstream input(document);
+    JSONReader reader(input);
+    auto catalogue = std::make_unique<transport::TransportCatalogue>();
+    reader.ParseCatalogue(*catalogue);
+    router::RoutingSettings settings = JSONReader::FillRoutingSettings(reader.GetRoutingSettings().AsMap());
+    settings.engine = engine;
+    settings.weight_type = weight_type;
+    settings.partition_cell_size = 16;
+    // Keeps the partition however many stops end up on cell boundaries.
+    settings.partition_max_boundary_share = 1.0;
+    const transport::TransportCatalogue& stops_source = *catalogue;
+    snapshot::SnapshotRegistry registry(std::make_unique<snapshot::Snapshot>(std::move(catalogue), reader.ParseRenderSettings(), settings));
+
+    std::vector<const transport::Stop*> stops;
+    for (const auto& [name, stop] : stops_source.GetAllStops()) {
+      if (stops.size() == CHECKED_STOPS) {
+        break;
+      }
+      stops.push_back(stop);
+    }
+
+    const auto old_snapshot = registry.Acquire();
+    const router::TransportRouter& old_router = old_snapshot->GetHandler().GetRouter();
+    std::vector<std::optional<double>> old_times;
+    for (const auto* from : stops) {
+      for (const auto* to : stops) {
+        old_times.push_back(GetTotalTime(old_router, from, to));
+      }
+    }
+
+    registry.Publish(old_snapshot->WithTimeSettings(NEW_TIME_SETTINGS));
+    const auto new_snapshot = registry.Acquire();
+    const router::TransportRouter& new_router = new_snapshot->GetHandler().GetRouter();
+    router::RoutingSettings new_settings = settings;
+    new_settings.bus_wait_time = NEW_TIME_SETTINGS.bus_wait_time;
+    new_settings.bus_velocity = NEW_TIME_SETTINGS.bus_velocity;
+    const router::TransportRouter expected_router(stops_source, new_settings);
+    if (new_router.GetSettings().bus_wait_time != NEW_TIME_SETTINGS.bus_wait_time
+        || new_router.GetSettings().bus_velocity != NEW_TIME_SETTINGS.bus_velocity) {
+      return "published router reports the old settings"s;
+    }
+
+    size_t changed = 0;
+    size_t index = 0;
+    for (const auto* from : stops) {
+      for (const auto* to : stops) {
+        const std::optional<double> new_time = GetTotalTime(new_router, from, to);
+        if (!SameTime(new_time, GetTotalTime(expected_router, from, to))) {
+          return "route "s + std::string(from->stop_name) + " -> "s + std::string(to->stop_name) + " differs from a rebuilt router"s;
+        }
+        if (!SameTime(old_times[index], GetTotalTime(old_router, from, to))) {
+          return "old snapshot changed for "s + std::string(from->stop_name) + " -> "s + std::string(to->stop_name);
+        }
+        changed += SameTime(new_time, old_times[index]) ? 0 : 1;
+        ++index;
+      }
+    }
+    if (changed == 0) {
+      return "no route changed"s;
+    }
+    return {};
+  }
+
+}
+
+int main() {
+  generator::NetworkOptions network;
+  network.stops = 400;
+  network.buses = 60;
+  network.requests.count = 1;
+  network.seed = 5;
+  std::ostringstream document;
+  generator::GenerateNetwork(network, document);
+
+  const std::vector<std::pair<std::string, router::RouteEngine>> engines = {
+    {"all_pairs"s, router::RouteEngine::ALL_PAIRS},
+    {"blocked_all_pairs"s, router::RouteEngine::BLOCKED_ALL_PAIRS},
+    {"shortest_path_trees"s, router::RouteEngine::SHORTEST_PATH_TREES},
+    {"landmarks"s, router::RouteEngine::LANDMARKS},
+    {"partitioned"s, router::RouteEngine::PARTITIONED},
+  };
+  const std::vector<std::pair<std::string, router::WeightType>> weight_types = {
+    {"minutes"s, router::WeightType::MINUTES},
+    {"fixed_milliseconds"s, router::WeightType::FIXED_MILLISECONDS},
+  };
+
+  bool failed = false;
+  for (const auto& [engine_name, engine] : engines) {
+    for (const auto& [weight_name, weight_type] : weight_types) {
+      const std::string error = Check(document.str(), engine, weight_type);
+      std::cout << engine_name << '/' << weight_name << ": " << (error.empty() ? "ok"s : error) << std::endl;
+      failed = failed || !error.empty();
+    }
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
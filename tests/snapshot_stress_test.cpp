@@ -0,0 +1,133 @@
+#include "snapshot.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+// Readers query the current snapshot while a writer keeps replacing it, with
+// more reader threads than one block of slots. Every snapshot has one bus
+// named after its version whose ride from A to B takes version minutes plus
+// the wait, so a reader that sees a bus from one version and times from
+// another, or a freed snapshot, fails the check. Run under -fsanitize=thread
+// or address.
+namespace {
+
+  const int VERSIONS = 200;
+  const size_t READERS = snapshot::SnapshotRegistry::READER_SLOTS + 32;
+
+  std::string MakeDocument(int version) {
+    // 60 km/h covers 1000 m a minute.
+    const std::string distance = std::to_string(1000 * version);
+    return R"({
+      "base_requests": [
+        {"type": "Stop", "name": "A", "latitude": 43.58, "longitude": 39.72, "road_distances": {"B": )"s + distance + R"(}},
+        {"type": "Stop", "name": "B", "latitude": 43.59, "longitude": 39.73, "road_distances": {"A": )"s + distance + R"(}},
+        {"type": "Bus", "name": "v)"s + std::to_string(version) + R"(", "stops": ["A", "B"], "is_roundtrip": false}
+      ],
+      "render_settings": {
+        "width": 200, "height": 200, "padding": 30, "stop_radius": 5, "line_width": 14,
+        "bus_label_font_size": 20, "bus_label_offset": [7, 15],
+        "stop_label_font_size": 20, "stop_label_offset": [7, -3],
+        "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3, "color_palette": ["green"]
+      },
+      "routing_settings": {"bus_wait_time": 2, "bus_velocity": 60}
+    })"s;
+  }
+
+  std::unique_ptr<snapshot::Snapshot> Build(int version) {
+    std::istringstream input(MakeDocument(version));
+    return snapshot::Snapshot::Load(input);
+  }
+
+  // Empty if the snapshot answers consistently with its own version.
+  std::string Check(const snapshot::Snapshot& current) {
+    const RequestHandler& handler = current.GetHandler();
+    const transport::TransportCatalogue& catalogue = handler.GetCatalogue();
+    const auto route = handler.GetRouter().FindRoute(catalogue.FindStop("A"), catalogue.FindStop("B"));
+    if (!route || route->GetItemCount() != 1) {
+      return "no single-ride route from A to B"s;
+    }
+    const router::RouteItem item = route->GetItem(0);
+    const int version = std::stoi(std::string(item.bus.substr(1)));
+    if (std::abs(item.time - item.wait_time - version) > 1e-6) {
+      return "bus "s + std::string(item.bus) + " rides "s + std::to_string(item.time) + " minutes"s;
+    }
+    return {};
+  }
+
+}
+
+int main() {
+  snapshot::SnapshotRegistry registry(Build(1));
+  std::atomic<bool> writing = true;
+  std::atomic<bool> failed = false;
+  std::atomic<size_t> reads = 0;
+
+  // With every slot of the first block taken, a reader has to get a slot
+  // from an added block instead of waiting, and the writer has to keep its
+  // snapshot retired, not released, until that reader is gone.
+  {
+    std::vector<snapshot::SnapshotRegistry::Reader> slot_readers;
+    slot_readers.reserve(snapshot::SnapshotRegistry::READER_SLOTS);
+    for (size_t i = 0; i < snapshot::SnapshotRegistry::READER_SLOTS; ++i) {
+      slot_readers.push_back(registry.Acquire());
+    }
+    const auto pinned = registry.Acquire();
+    registry.Publish(Build(2));
+    slot_readers.clear();
+    if (registry.Reclaim() != 1) {
+      std::cerr << "snapshot of the reader in an added block was not kept retired" << std::endl;
+      failed = true;
+    }
+    const std::string error = Check(*pinned);
+    if (!error.empty() || !pinned->GetHandler().GetCatalogue().FindBus("v1")) {
+      std::cerr << "snapshot of the reader in an added block lost " << error << std::endl;
+      failed = true;
+    }
+  }
+
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < READERS; ++i) {
+    readers.emplace_back([&registry, &writing, &failed, &reads] {
+      while (writing.load() && !failed.load()) {
+        const auto current = registry.Acquire();
+        if (const std::string error = Check(*current); !error.empty()) {
+          std::cerr << error << std::endl;
+          failed = true;
+        }
+        reads.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  for (int version = 3; version <= VERSIONS && !failed.load(); ++version) {
+    if (version % 4 == 0) {
+      registry.PublishAsync([version] { return Build(version); }).get();
+    }
+    else {
+      registry.Publish(Build(version));
+    }
+  }
+  writing = false;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  if (const size_t retired = registry.Reclaim(); retired != 0) {
+    std::cerr << retired << " snapshots still retired with no readers left" << std::endl;
+    failed = true;
+  }
+  if (const std::string error = Check(*registry.Acquire()); !error.empty()) {
+    std::cerr << error << std::endl;
+    failed = true;
+  }
+  std::cout << (failed ? "FAILED"s : "ok"s) << ": " << reads.load() << " reads over " << VERSIONS << " snapshots" << std::endl;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
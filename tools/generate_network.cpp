@@ -0,0 +1,58 @@
+#include "network_generator.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+  void PrintUsage() {
+    std::cerr << "usage: generate_network [--stops=N] [--buses=N] [--route-length=fixed:N|uniform:MIN:MAX|geometric:MEAN:MIN:MAX]\n"
+                 "                        [--roundtrip-ratio=R] [--topology=grid|radial|corridor]\n"
+                 "                        [--requests=N] [--mix=stop:W,bus:W,route:W,map:W] [--seed=N] [--output=FILE]"
+              << std::endl;
+  }
+
+}
+
+int main(int argc, char* argv[]) {
+  generator::NetworkOptions options;
+  std::string mix;
+  int requests = options.requests.count;
+  std::string output;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const auto eq = arg.find('=');
+      if (eq == std::string::npos) throw std::invalid_argument(arg);
+      const std::string key = arg.substr(0, eq);
+      const std::string value = arg.substr(eq + 1);
+      if (key == "--stops") options.stops = std::stoi(value);
+      else if (key == "--buses") options.buses = std::stoi(value);
+      else if (key == "--route-length") options.route_length = generator::ParseRouteLength(value);
+      else if (key == "--roundtrip-ratio") options.roundtrip_ratio = std::stod(value);
+      else if (key == "--topology") options.topology = generator::ParseTopology(value);
+      else if (key == "--requests") requests = std::stoi(value);
+      else if (key == "--mix") mix = value;
+      else if (key == "--seed") options.seed = std::stoull(value);
+      else if (key == "--output") output = value;
+      else throw std::invalid_argument(arg);
+    }
+    options.requests = mix.empty() ? generator::RequestMix{} : generator::ParseRequestMix(requests, mix);
+    options.requests.count = requests;
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    PrintUsage();
+    return 1;
+  }
+
+  if (output.empty()) {
+    generator::GenerateNetwork(options, std::cout);
+  }
+  else {
+    std::ofstream out(output);
+    generator::GenerateNetwork(options, out);
+  }
+}
@@ -0,0 +1,283 @@
+#include "network_generator.h"
+
+#include "geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::literals;
+
+namespace generator {
+
+  namespace {
+
+    class Random {
+      public:
+        explicit Random(uint64_t seed) : engine_(seed) {}
+
+        // Uniform in [0, 1) from the top 53 bits.
+        double Real() {
+          return static_cast <double> (engine_() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        // Uniform in [min, max].
+        int Int(int min, int max) {
+          return min + static_cast <int> (Real() * (static_cast <double> (max) - min + 1));
+        }
+
+      private:
+        std::mt19937_64 engine_;
+    };
+
+    const double BASE_LAT = 55.5;
+    const double BASE_LNG = 37.3;
+    const double SPAN = 0.4;
+
+    struct Network {
+      std::vector <geo::Coordinates> coordinates;
+      std::vector <std::vector <int>> neighbours;
+    };
+
+    void Connect(Network& network, int from, int to) {
+      network.neighbours[from].push_back(to);
+      network.neighbours[to].push_back(from);
+    }
+
+    Network MakeGrid(int stops) {
+      Network network;
+      const int side = std::max(1, static_cast <int> (std::ceil(std::sqrt(static_cast <double> (stops)))));
+      network.coordinates.resize(stops);
+      network.neighbours.resize(stops);
+      for (int stop = 0; stop < stops; ++stop) {
+        const int row = stop / side;
+        const int column = stop % side;
+        network.coordinates[stop] = {BASE_LAT + SPAN * row / side, BASE_LNG + SPAN * column / side};
+        if (column > 0) Connect(network, stop, stop - 1);
+        if (row > 0) Connect(network, stop, stop - side);
+      }
+      return network;
+    }
+
+    // Stop 0 is the centre; the others sit on rings crossed by spokes.
+    Network MakeRadial(int stops) {
+      Network network;
+      network.coordinates.resize(stops);
+      network.neighbours.resize(stops);
+      network.coordinates[0] = {BASE_LAT + SPAN / 2, BASE_LNG + SPAN / 2};
+      const int spokes = std::max(3, static_cast <int> (std::sqrt(static_cast <double> (stops))));
+      const int rings = (stops - 1 + spokes - 1) / spokes;
+      for (int stop = 1; stop < stops; ++stop) {
+        const int ring = (stop - 1) / spokes;
+        const int spoke = (stop - 1) % spokes;
+        const double radius = SPAN / 2 * (ring + 1) / std::max(1, rings);
+        const double angle = 2 * 3.14159265358979 * spoke / spokes;
+        network.coordinates[stop] = {BASE_LAT + SPAN / 2 + radius * std::sin(angle), BASE_LNG + SPAN / 2 + radius * std::cos(angle)};
+        Connect(network, stop, ring == 0 ? 0 : stop - spokes);
+        if (spoke > 0) Connect(network, stop, stop - 1);
+        if (spoke == spokes - 1 && spokes > 2) Connect(network, stop, stop - spokes + 1);
+      }
+      return network;
+    }
+
+    // A long, narrow band of three parallel lanes.
+    Network MakeCorridor(int stops) {
+      Network network;
+      const int lanes = std::min(3, stops);
+      const int length = (stops + lanes - 1) / lanes;
+      network.coordinates.resize(stops);
+      network.neighbours.resize(stops);
+      for (int stop = 0; stop < stops; ++stop) {
+        const int position = stop / lanes;
+        const int lane = stop % lanes;
+        network.coordinates[stop] = {BASE_LAT + SPAN / 50 * lane, BASE_LNG + SPAN * position / std::max(1, length)};
+        if (position > 0) Connect(network, stop, stop - lanes);
+        if (lane > 0) Connect(network, stop, stop - 1);
+      }
+      return network;
+    }
+
+    int DrawLength(const RouteLength& length, Random& random) {
+      switch (length.distribution) {
+      case LengthDistribution::FIXED:
+        return length.min;
+      case LengthDistribution::UNIFORM:
+        return random.Int(length.min, length.max);
+      case LengthDistribution::GEOMETRIC: {
+        const double p = 1.0 / std::max(1.0, length.mean - length.min + 1);
+        const double draw = std::floor(std::log(1.0 - random.Real()) / std::log(1.0 - std::min(p, 0.999999)));
+        return std::clamp(length.min + static_cast <int> (draw), length.min, length.max);
+      }
+      }
+      return length.min;
+    }
+
+    // Walks the topology from a random stop without stepping straight back,
+    // so buses follow streets instead of bouncing between two stops.
+    std::vector <int> DrawRoute(const Network& network, int length, Random& random) {
+      std::vector <int> route;
+      const int stops = static_cast <int> (network.coordinates.size());
+      int current = random.Int(0, stops - 1);
+      int previous = -1;
+      route.push_back(current);
+      while (static_cast <int> (route.size()) < length) {
+        const auto& neighbours = network.neighbours[current];
+        if (neighbours.empty()) break;
+        int next = neighbours[random.Int(0, static_cast <int> (neighbours.size()) - 1)];
+        if (next == previous && neighbours.size() > 1) {
+          next = neighbours[random.Int(0, static_cast <int> (neighbours.size()) - 1)];
+        }
+        previous = current;
+        current = next;
+        route.push_back(current);
+      }
+      return route;
+    }
+
+    std::string StopName(int stop) {
+      return "S"s + std::to_string(stop);
+    }
+
+    std::string BusName(int bus) {
+      return "B"s + std::to_string(bus);
+    }
+
+  }
+
+  void GenerateNetwork(const NetworkOptions& options, std::ostream& out) {
+    if (options.stops < 1 || options.buses < 0) throw std::invalid_argument("stops must be positive");
+    Random random(options.seed);
+    const Network network = options.topology == Topology::GRID ? MakeGrid(options.stops)
+      : options.topology == Topology::RADIAL ? MakeRadial(options.stops) : MakeCorridor(options.stops);
+
+    std::vector <std::vector <int>> routes(options.buses);
+    std::vector <bool> roundtrips(options.buses);
+    std::vector <std::vector <std::pair <int, int>>> road_distances(options.stops);
+    for (int bus = 0; bus < options.buses; ++bus) {
+      routes[bus] = DrawRoute(network, std::max(2, DrawLength(options.route_length, random)), random);
+      roundtrips[bus] = random.Real() < options.roundtrip_ratio;
+      if (roundtrips[bus]) routes[bus].push_back(routes[bus].front());
+      for (size_t i = 0; i + 1 < routes[bus].size(); ++i) {
+        const int from = routes[bus][i];
+        const int to = routes[bus][i + 1];
+        const double straight = geo::ComputeDistance(network.coordinates[from], network.coordinates[to]);
+        road_distances[from].push_back({to, static_cast <int> (straight * (1.1 + 0.4 * random.Real())) + 1});
+      }
+    }
+
+    out << std::setprecision(9);
+    out << "{\n  \"base_requests\": [";
+    bool first = true;
+    for (int stop = 0; stop < options.stops; ++stop) {
+      auto& distances = road_distances[stop];
+      std::sort(distances.begin(), distances.end());
+      distances.erase(std::unique(distances.begin(), distances.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+      }), distances.end());
+      out << (first ? "\n" : ",\n") << "    {\"type\": \"Stop\", \"name\": \"" << StopName(stop)
+          << "\", \"latitude\": " << network.coordinates[stop].lat
+          << ", \"longitude\": " << network.coordinates[stop].lng << ", \"road_distances\": {";
+      for (size_t i = 0; i < distances.size(); ++i) {
+        out << (i ? ", " : "") << '"' << StopName(distances[i].first) << "\": " << distances[i].second;
+      }
+      out << "}}";
+      first = false;
+    }
+    for (int bus = 0; bus < options.buses; ++bus) {
+      out << (first ? "\n" : ",\n") << "    {\"type\": \"Bus\", \"name\": \"" << BusName(bus) << "\", \"stops\": [";
+      for (size_t i = 0; i < routes[bus].size(); ++i) {
+        out << (i ? ", " : "") << '"' << StopName(routes[bus][i]) << '"';
+      }
+      out << "], \"is_roundtrip\": " << (roundtrips[bus] ? "true" : "false") << "}";
+      first = false;
+    }
+    out << "\n  ],\n";
+
+    out << "  \"render_settings\": {\"width\": 1200, \"height\": 1200, \"padding\": 50, \"line_width\": 14, "
+           "\"stop_radius\": 5, \"bus_label_font_size\": 20, \"bus_label_offset\": [7, 15], "
+           "\"stop_label_font_size\": 20, \"stop_label_offset\": [7, -3], \"underlayer_color\": [255, 255, 255, 0.85], "
+           "\"underlayer_width\": 3, \"color_palette\": [\"green\", [255, 160, 0], \"red\"]},\n";
+    out << "  \"routing_settings\": {\"bus_wait_time\": " << options.bus_wait_time
+        << ", \"bus_velocity\": " << options.bus_velocity << "},\n";
+
+    out << "  \"stat_requests\": [";
+    const RequestMix& mix = options.requests;
+    const int total_weight = mix.stop_weight + mix.bus_weight + mix.route_weight + mix.map_weight;
+    for (int id = 1; id <= mix.count && total_weight > 0; ++id) {
+      const int draw = random.Int(0, total_weight - 1);
+      out << (id == 1 ? "\n" : ",\n") << "    {\"id\": " << id << ", ";
+      if (draw < mix.stop_weight) {
+        out << "\"type\": \"Stop\", \"name\": \"" << StopName(random.Int(0, options.stops - 1)) << "\"}";
+      }
+      else if (draw < mix.stop_weight + mix.bus_weight && options.buses > 0) {
+        out << "\"type\": \"Bus\", \"name\": \"" << BusName(random.Int(0, options.buses - 1)) << "\"}";
+      }
+      else if (draw < mix.stop_weight + mix.bus_weight + mix.route_weight || options.buses == 0) {
+        out << "\"type\": \"Route\", \"from\": \"" << StopName(random.Int(0, options.stops - 1))
+            << "\", \"to\": \"" << StopName(random.Int(0, options.stops - 1)) << "\"}";
+      }
+      else {
+        out << "\"type\": \"Map\"}";
+      }
+    }
+    out << "\n  ]\n}\n";
+  }
+
+  Topology ParseTopology(const std::string& name) {
+    if (name == "grid") return Topology::GRID;
+    if (name == "radial") return Topology::RADIAL;
+    if (name == "corridor") return Topology::CORRIDOR;
+    throw std::invalid_argument("unknown topology " + name);
+  }
+
+  // "fixed:N", "uniform:MIN:MAX" or "geometric:MEAN:MIN:MAX".
+  RouteLength ParseRouteLength(const std::string& spec) {
+    std::vector <std::string> parts;
+    std::istringstream in(spec);
+    for (std::string part; std::getline(in, part, ':');) parts.push_back(part);
+    RouteLength length;
+    if (parts.size() == 2 && parts[0] == "fixed") {
+      length.distribution = LengthDistribution::FIXED;
+      length.min = length.max = std::stoi(parts[1]);
+    }
+    else if (parts.size() == 3 && parts[0] == "uniform") {
+      length.distribution = LengthDistribution::UNIFORM;
+      length.min = std::stoi(parts[1]);
+      length.max = std::stoi(parts[2]);
+    }
+    else if (parts.size() == 4 && parts[0] == "geometric") {
+      length.distribution = LengthDistribution::GEOMETRIC;
+      length.mean = std::stod(parts[1]);
+      length.min = std::stoi(parts[2]);
+      length.max = std::stoi(parts[3]);
+    }
+    else {
+      throw std::invalid_argument("bad route length " + spec);
+    }
+    if (length.min < 2 || length.max < length.min) throw std::invalid_argument("bad route length " + spec);
+    return length;
+  }
+
+  // "stop:40,bus:30,route:25,map:5"; missing types get weight 0.
+  RequestMix ParseRequestMix(int count, const std::string& spec) {
+    RequestMix mix {count, 0, 0, 0, 0};
+    std::istringstream in(spec);
+    for (std::string item; std::getline(in, item, ',');) {
+      const auto colon = item.find(':');
+      if (colon == std::string::npos) throw std::invalid_argument("bad request mix " + spec);
+      const std::string type = item.substr(0, colon);
+      const int weight = std::stoi(item.substr(colon + 1));
+      if (type == "stop") mix.stop_weight = weight;
+      else if (type == "bus") mix.bus_weight = weight;
+      else if (type == "route") mix.route_weight = weight;
+      else if (type == "map") mix.map_weight = weight;
+      else throw std::invalid_argument("unknown request type " + type);
+    }
+    return mix;
+  }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace generator {
+
+  enum class Topology {
+    GRID,
+    RADIAL,
+    CORRIDOR,
+  };
+
+  enum class LengthDistribution {
+    FIXED,
+    UNIFORM,
+    GEOMETRIC,
+  };
+
+  // Number of stops per bus. FIXED uses min, UNIFORM draws from [min, max],
+  // GEOMETRIC has the given mean and is clamped to [min, max].
+  struct RouteLength {
+    LengthDistribution distribution = LengthDistribution::UNIFORM;
+    int min = 5;
+    int max = 20;
+    double mean = 10.0;
+  };
+
+  struct RequestMix {
+    int count = 100;
+    int stop_weight = 40;
+    int bus_weight = 30;
+    int route_weight = 25;
+    int map_weight = 5;
+  };
+
+  struct NetworkOptions {
+    int stops = 1000;
+    int buses = 100;
+    RouteLength route_length;
+    double roundtrip_ratio = 0.3;
+    Topology topology = Topology::GRID;
+    RequestMix requests;
+    uint64_t seed = 1;
+    int bus_wait_time = 6;
+    double bus_velocity = 40.0;
+  };
+
+  // Writes one JSON document with base_requests, render_settings,
+  // routing_settings and stat_requests as JSONReader reads them. The output
+  // depends only on the options: random numbers come from mt19937_64, whose
+  // sequence is fixed by the standard, and are mapped without the
+  // implementation-defined std distributions.
+  void GenerateNetwork(const NetworkOptions& options, std::ostream& out);
+
+  Topology ParseTopology(const std::string& name);
+  RouteLength ParseRouteLength(const std::string& spec);
+  RequestMix ParseRequestMix(int count, const std::string& spec);
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "graph.h"
+#include "memory_usage.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace graph {
+
+// All-pairs table like Router, stored as two flat row-major arrays: narrow
+// weights (StoredWeight) and 32-bit previous edges. It is filled by a tiled
+// Floyd-Warshall: for every diagonal tile, first the tile itself, then its
+// row and column of tiles, then all the others, with each of the last two
+// phases split across threads. The inner kernel is a branchless min-plus
+// over contiguous rows so the compiler can vectorize it.
+template <typename Weight, typename StoredWeight = float>
+class DenseRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit DenseRouter(const Graph& graph, size_t threads = 0);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    memory::Usage GetMemoryUsage() const;
+
+private:
+    static constexpr size_t TILE = 64;
+    static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+    // Half the range for integers, so that adding two "infinite" entries
+    // cannot wrap around.
+    static constexpr StoredWeight INFINITE_WEIGHT = std::numeric_limits<StoredWeight>::has_infinity
+        ? std::numeric_limits<StoredWeight>::infinity()
+        : std::numeric_limits<StoredWeight>::max() / 2;
+
+    void RelaxTile(size_t row_tile, size_t column_tile, size_t through_tile);
+    template <typename Function>
+    void ForEachInParallel(size_t count, Function function) const;
+
+    const Graph& graph_;
+    size_t vertex_count_;
+    size_t stride_;
+    size_t threads_;
+    std::vector<StoredWeight> weights_;
+    std::vector<uint32_t> prev_edges_;
+};
+
+template <typename Weight, typename StoredWeight>
+DenseRouter<Weight, StoredWeight>::DenseRouter(const Graph& graph, size_t threads)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , stride_((graph.GetVertexCount() + TILE - 1) / TILE * TILE)
+    , threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    , weights_(stride_ * stride_, INFINITE_WEIGHT)
+    , prev_edges_(stride_ * stride_, NO_EDGE)
+{
+    if (graph.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("too many edges for 32-bit edge ids");
+    }
+    for (VertexId vertex = 0; vertex < stride_; ++vertex) {
+        weights_[vertex * stride_ + vertex] = StoredWeight{};
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < Weight{}) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            const StoredWeight weight = static_cast<StoredWeight>(edge.weight);
+            const size_t cell = vertex * stride_ + edge.to;
+            if (edge.to != vertex && weight < weights_[cell]) {
+                weights_[cell] = weight;
+                prev_edges_[cell] = static_cast<uint32_t>(edge_id);
+            }
+        }
+    }
+
+    const size_t tiles = stride_ / TILE;
+    for (size_t through = 0; through < tiles; ++through) {
+        RelaxTile(through, through, through);
+        ForEachInParallel(2 * tiles, [this, through, tiles](size_t task) {
+            const size_t other = task % tiles;
+            if (other == through) {
+                return;
+            }
+            if (task < tiles) {
+                RelaxTile(through, other, through);
+            }
+            else {
+                RelaxTile(other, through, through);
+            }
+        });
+        ForEachInParallel(tiles, [this, through, tiles](size_t row_tile) {
+            if (row_tile == through) {
+                return;
+            }
+            for (size_t column_tile = 0; column_tile < tiles; ++column_tile) {
+                if (column_tile != through) {
+                    RelaxTile(row_tile, column_tile, through);
+                }
+            }
+        });
+    }
+}
+
+template <typename Weight, typename StoredWeight>
+void DenseRouter<Weight, StoredWeight>::RelaxTile(size_t row_tile, size_t column_tile, size_t through_tile) {
+    const size_t row_begin = row_tile * TILE;
+    const size_t column_begin = column_tile * TILE;
+    const size_t through_begin = through_tile * TILE;
+    for (size_t through = through_begin; through < through_begin + TILE; ++through) {
+        const StoredWeight* through_weights = weights_.data() + through * stride_ + column_begin;
+        const uint32_t* through_edges = prev_edges_.data() + through * stride_ + column_begin;
+        for (size_t row = row_begin; row < row_begin + TILE; ++row) {
+            const StoredWeight to_through = weights_[row * stride_ + through];
+            if (to_through == INFINITE_WEIGHT) {
+                continue;
+            }
+            StoredWeight* row_weights = weights_.data() + row * stride_ + column_begin;
+            uint32_t* row_edges = prev_edges_.data() + row * stride_ + column_begin;
+            for (size_t column = 0; column < TILE; ++column) {
+                const StoredWeight candidate = to_through + through_weights[column];
+                const bool better = candidate < row_weights[column];
+                row_weights[column] = better ? candidate : row_weights[column];
+                row_edges[column] = better ? through_edges[column] : row_edges[column];
+            }
+        }
+    }
+}
+
+template <typename Weight, typename StoredWeight>
+template <typename Function>
+void DenseRouter<Weight, StoredWeight>::ForEachInParallel(size_t count, Function function) const {
+    const size_t workers = std::min(threads_, count);
+    if (workers <= 1) {
+        for (size_t task = 0; task < count; ++task) {
+            function(task);
+        }
+        return;
+    }
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(workers - 1);
+    for (size_t worker = 1; worker < workers; ++worker) {
+        tasks.push_back(std::async(std::launch::async, [&function, worker, workers, count] {
+            for (size_t task = worker; task < count; task += workers) {
+                function(task);
+            }
+        }));
+    }
+    for (size_t task = 0; task < count; task += workers) {
+        function(task);
+    }
+    for (auto& task : tasks) {
+        task.get();
+    }
+}
+
+template <typename Weight, typename StoredWeight>
+std::optional<typename DenseRouter<Weight, StoredWeight>::RouteInfo>
+DenseRouter<Weight, StoredWeight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("vertex is out of range");
+    }
+    if (weights_[from * stride_ + to] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    // The stored weight is narrowed, so the reported one is summed again
+    // from the graph's own edge weights.
+    Weight weight{};
+    std::vector<EdgeId> edges;
+    for (uint32_t edge_id = prev_edges_[from * stride_ + to];
+         edge_id != NO_EDGE;
+         edge_id = prev_edges_[from * stride_ + graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+    std::reverse(edges.begin(), edges.end());
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight, typename StoredWeight>
+memory::Usage DenseRouter<Weight, StoredWeight>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("dense_weights", memory::TotalMemory(weights_));
+    usage.Add("dense_prev_edges", memory::TotalMemory(prev_edges_));
+    return usage;
+}
+
+}  // namespace graph
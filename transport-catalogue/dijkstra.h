@@ -0,0 +1,196 @@
+#pragma once
+
+#include "graph.h"
+#include "min_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace graph {
+
+// Single-source search over DirectedWeightedGraph that keeps its buffers
+// between runs. Per-vertex state is valid only when stamped with the current
+// run's generation, so starting a new run is O(1) however much of the graph
+// the previous one touched. One instance serves one thread. Unsigned integer
+// weights get a radix queue instead of a binary heap.
+template <typename Weight>
+class Dijkstra {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit Dijkstra(const Graph& graph);
+
+    // Settles vertices in order of distance from source until every target is
+    // settled or the reachable part of the graph is exhausted.
+    void Run(VertexId source, const std::vector<VertexId>& targets);
+    // A* towards one target: vertices are settled in order of distance plus
+    // lower_bound(vertex), and the run stops once target is settled. The
+    // bound must be consistent (drop by no more than an edge's weight along
+    // it); vertices it reports as max() cannot reach target and are skipped.
+    template <typename LowerBound>
+    void RunTowards(VertexId source, VertexId target, LowerBound lower_bound);
+    // The same with each edge weighing edge_weight(edge id) instead of its
+    // stored weight, so one graph can be searched under other weightings.
+    // The bound must be consistent for those weights.
+    template <typename LowerBound, typename EdgeWeight>
+    void RunTowards(VertexId source, VertexId target, LowerBound lower_bound, EdgeWeight edge_weight);
+    std::optional<Weight> GetDistance(VertexId vertex) const;
+    std::optional<EdgeId> GetPrevEdge(VertexId vertex) const;
+    const Graph& GetGraph() const;
+
+private:
+    void Reset();
+    bool IsReached(VertexId vertex) const;
+    bool IsSettled(VertexId vertex) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    uint32_t generation_ = 0;
+    VertexId source_ = 0;
+    std::vector<Weight> distances_;
+    std::vector<EdgeId> prev_edges_;
+    // Generation in which the vertex was reached, settled or marked a target.
+    std::vector<uint32_t> reached_;
+    std::vector<uint32_t> settled_;
+    std::vector<uint32_t> is_target_;
+    MinQueue<Weight> queue_;
+};
+
+template <typename Weight>
+Dijkstra<Weight>::Dijkstra(const Graph& graph)
+    : graph_(graph)
+    , distances_(graph.GetVertexCount(), ZERO_WEIGHT)
+    , prev_edges_(graph.GetVertexCount())
+    , reached_(graph.GetVertexCount(), 0)
+    , settled_(graph.GetVertexCount(), 0)
+    , is_target_(graph.GetVertexCount(), 0)
+{
+}
+
+template <typename Weight>
+void Dijkstra<Weight>::Reset() {
+    if (++generation_ == 0) {
+        std::fill(reached_.begin(), reached_.end(), 0);
+        std::fill(settled_.begin(), settled_.end(), 0);
+        std::fill(is_target_.begin(), is_target_.end(), 0);
+        generation_ = 1;
+    }
+    queue_.Clear();
+}
+
+template <typename Weight>
+bool Dijkstra<Weight>::IsReached(VertexId vertex) const {
+    return generation_ != 0 && reached_[vertex] == generation_;
+}
+
+template <typename Weight>
+bool Dijkstra<Weight>::IsSettled(VertexId vertex) const {
+    return generation_ != 0 && settled_[vertex] == generation_;
+}
+
+template <typename Weight>
+void Dijkstra<Weight>::Run(VertexId source, const std::vector<VertexId>& targets) {
+    Reset();
+    size_t targets_left = 0;
+    for (VertexId target : targets) {
+        if (is_target_[target] != generation_) {
+            is_target_[target] = generation_;
+            ++targets_left;
+        }
+    }
+
+    source_ = source;
+    distances_[source] = ZERO_WEIGHT;
+    reached_[source] = generation_;
+    queue_.Push(ZERO_WEIGHT, source);
+    while (!queue_.IsEmpty() && (targets.empty() || targets_left > 0)) {
+        const auto [weight, vertex] = queue_.Pop();
+        if (settled_[vertex] == generation_) {
+            continue;
+        }
+        settled_[vertex] = generation_;
+        if (is_target_[vertex] == generation_) {
+            --targets_left;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = weight + edge.weight;
+            if (reached_[edge.to] != generation_ || candidate < distances_[edge.to]) {
+                reached_[edge.to] = generation_;
+                distances_[edge.to] = candidate;
+                prev_edges_[edge.to] = edge_id;
+                queue_.Push(candidate, edge.to);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+template <typename LowerBound>
+void Dijkstra<Weight>::RunTowards(VertexId source, VertexId target, LowerBound lower_bound) {
+    RunTowards(source, target, lower_bound, [this](EdgeId edge_id) {
+        return graph_.GetEdge(edge_id).weight;
+    });
+}
+
+template <typename Weight>
+template <typename LowerBound, typename EdgeWeight>
+void Dijkstra<Weight>::RunTowards(VertexId source, VertexId target, LowerBound lower_bound, EdgeWeight edge_weight) {
+    Reset();
+    source_ = source;
+    distances_[source] = ZERO_WEIGHT;
+    reached_[source] = generation_;
+    queue_.Push(lower_bound(source), source);
+    while (!queue_.IsEmpty()) {
+        const VertexId vertex = queue_.Pop().second;
+        if (settled_[vertex] == generation_) {
+            continue;
+        }
+        settled_[vertex] = generation_;
+        if (vertex == target) {
+            break;
+        }
+        const Weight weight = distances_[vertex];
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = weight + edge_weight(edge_id);
+            if (reached_[edge.to] != generation_ || candidate < distances_[edge.to]) {
+                const Weight bound = lower_bound(edge.to);
+                if (bound == std::numeric_limits<Weight>::max()) {
+                    continue;
+                }
+                reached_[edge.to] = generation_;
+                distances_[edge.to] = candidate;
+                prev_edges_[edge.to] = edge_id;
+                queue_.Push(candidate + bound, edge.to);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<Weight> Dijkstra<Weight>::GetDistance(VertexId vertex) const {
+    if (!IsSettled(vertex)) {
+        return std::nullopt;
+    }
+    return distances_[vertex];
+}
+
+template <typename Weight>
+std::optional<EdgeId> Dijkstra<Weight>::GetPrevEdge(VertexId vertex) const {
+    if (!IsReached(vertex) || vertex == source_) {
+        return std::nullopt;
+    }
+    return prev_edges_[vertex];
+}
+
+template <typename Weight>
+const DirectedWeightedGraph<Weight>& Dijkstra<Weight>::GetGraph() const {
+    return graph_;
+}
+
+}  // namespace graph
@@ -2,6 +2,7 @@
 
 #include "geo.h"
 
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <set>
@@ -11,19 +12,27 @@ namespace transport {
 
   struct Bus;
 
+  // Names and lists below are allocated from the catalogue's resource.
   struct Stop {
-    std::string stop_name;
+    std::pmr::string stop_name;
     geo::Coordinates coordinates;
-    std::set < std::string > buses;
+    std::pmr::set < std::pmr::string > buses;
     bool operator == (const Stop & other) {
       return stop_name == other.stop_name && coordinates == other.coordinates;
     }
   };
 
+  // Times in minutes at every stop of one run of the bus, in traversal order:
+  // stops.size() entries for a roundtrip, stops.size() * 2 - 1 otherwise.
+  struct Trip {
+    std::pmr::vector < double > times;
+  };
+
   struct Bus {
-    std::string bus_name;
-    std::vector < Stop * > stops;
+    std::pmr::string bus_name;
+    std::pmr::vector < Stop * > stops;
     bool is_roundtrip;
+    std::pmr::vector < Trip > trips;
     bool operator == (const Bus & other) {
       return bus_name == other.bus_name;
     }
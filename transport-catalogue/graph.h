@@ -1,8 +1,10 @@
 #pragma once
 
+#include "memory_usage.h"
 #include "ranges.h"
 
 #include <cstdlib>
+#include <memory_resource>
 #include <vector>
 
 namespace graph {
@@ -22,27 +24,30 @@ struct Edge {
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
+    using IncidenceList = std::pmr::vector<EdgeId>;
     using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
 
 public:
     DirectedWeightedGraph() = default;
-    explicit DirectedWeightedGraph(size_t vertex_count);
+    explicit DirectedWeightedGraph(size_t vertex_count,
+                                   std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     EdgeId AddEdge(const Edge<Weight>& edge);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    memory::Usage GetMemoryUsage() const;
 
 private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    std::pmr::vector<Edge<Weight>> edges_;
+    std::pmr::vector<IncidenceList> incidence_lists_;
 };
 
 template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::pmr::memory_resource* resource)
+    : edges_(resource)
+    , incidence_lists_(vertex_count, resource) {
 }
 
 template <typename Weight>
@@ -73,4 +78,11 @@ typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
     return ranges::AsRange(incidence_lists_.at(vertex));
 }
+template <typename Weight>
+memory::Usage DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("edges", memory::TotalMemory(edges_));
+    usage.Add("incidence_lists", memory::TotalMemory(incidence_lists_));
+    return usage;
+}
 }  // namespace graph
@@ -1,4 +1,5 @@
 #include "json.h"
+#include "memory_usage.h"
 
 using namespace std;
 
@@ -217,6 +218,45 @@ namespace json {
     };
   }
 
+  void LoadStream(std::istream & input, StreamHandler & handler) {
+    char current_char;
+    if (!(input >> current_char) || current_char != '{') {
+      throw ParsingError("Dictionary is expected"s);
+    }
+    while (input >> current_char && current_char != '}') {
+      if (current_char == ',') {
+        continue;
+      }
+      if (current_char != '"') {
+        throw ParsingError("Key is expected but '"s + current_char + "' has been found"s);
+      }
+      std::string key = LoadString(input);
+      if (!(input >> current_char) || current_char != ':') {
+        throw ParsingError(": is expected after key '"s + key + "'"s);
+      }
+      if (!handler.IsStreamed(key)) {
+        handler.OnValue(std::move(key), LoadNode(input));
+        continue;
+      }
+      if (!(input >> current_char) || current_char != '[') {
+        throw ParsingError("Array is expected for key '"s + key + "'"s);
+      }
+      while (input >> current_char && current_char != ']') {
+        if (current_char != ',') {
+          input.putback(current_char);
+        }
+        handler.OnElement(key, LoadNode(input));
+      }
+      if (!input) {
+        throw ParsingError("Array parsing error"s);
+      }
+      handler.OnArrayEnd(key);
+    }
+    if (!input) {
+      throw ParsingError("Dictionary parsing error"s);
+    }
+  }
+
   struct PrintContext {
     std::ostream & out;
     int indent_step = 4;
@@ -244,32 +284,36 @@ namespace json {
     ctx.out << value;
     }
 
-  void PrintValue(const std::string & value,
-    const PrintContext & ctx) {
-    ctx.out.put('"');
+  void PrintString(std::string_view value, std::ostream & output) {
+    output.put('"');
     for (const char current_char: value) {
       switch (current_char) {
       case '\r':
-        ctx.out << R "(\r)";
+        output << R "(\r)";
         break;
       case '\n':
-        ctx.out << R "(\n)";
+        output << R "(\n)";
         break;
       case '\t':
-        ctx.out << R "(\t)";
+        output << R "(\t)";
         break;
       case '"':
-        ctx.out << R "(\")";
+        output << R "(\")";
         break;
       case '\\':
-        ctx.out << R "(\\)";
+        output << R "(\\)";
         break;
       default:
-        ctx.out.put(current_char);
+        output.put(current_char);
         break;
       }
     }
-    ctx.out.put('"');
+    output.put('"');
+  }
+
+  void PrintValue(const std::string & value,
+    const PrintContext & ctx) {
+    PrintString(value, ctx.out);
   }
 
   void PrintValue(const std::nullptr_t &, const PrintContext & ctx) {
@@ -331,6 +375,21 @@ namespace json {
       node.GetValue());
   }
 
+  size_t DynamicMemory(const Node & node) {
+    if (node.IsArray()) return memory::DynamicMemory(node.AsArray());
+    if (node.IsMap()) return memory::DynamicMemory(node.AsMap());
+    if (node.IsString()) return memory::DynamicMemory(node.AsString());
+    return 0;
+  }
+
+  void PrintIndented(const Node & node, std::ostream & output, int indent) {
+    PrintNode(node, PrintContext {
+      output,
+      4,
+      indent
+    });
+  }
+
   void Print(const Document & doc, std::ostream & output) {
     PrintNode(doc.GetRoot(), PrintContext {
       output
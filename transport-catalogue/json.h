@@ -3,6 +3,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
@@ -132,6 +133,8 @@ namespace json {
 
   class Document {
     public: explicit Document(Node root): root_(std::move(root)) {}
+    // Builds the root dictionary in place rather than moving a Node in.
+    explicit Document(Dict root): root_(std::move(root)) {}
 
     const Node& GetRoot() const {
       return root_;
@@ -142,6 +145,20 @@ namespace json {
 
   Document Load(std::istream & input);
 
+  // Receives a top-level dictionary while it is being parsed.
+  class StreamHandler {
+    public:
+    virtual ~StreamHandler() = default;
+    // Arrays under these keys are handed over element by element.
+    virtual bool IsStreamed(const std::string & key) const = 0;
+    virtual void OnElement(const std::string & key, Node element) = 0;
+    virtual void OnArrayEnd(const std::string & key) = 0;
+    // Any other value is handed over whole once parsed.
+    virtual void OnValue(std::string key, Node value) = 0;
+  };
+
+  void LoadStream(std::istream & input, StreamHandler & handler);
+
   inline bool operator == (const Document & lhs, const Document & rhs) {
     return lhs.GetRoot() == rhs.GetRoot();
   }
@@ -151,4 +168,10 @@ namespace json {
   }
 
   void Print(const Document & doc, std::ostream & output);
+  // Prints node laid out as Print would lay it out indent spaces deep, so a
+  // document can be written piece by piece.
+  void PrintIndented(const Node & node, std::ostream & output, int indent);
+  void PrintString(std::string_view value, std::ostream & output);
+
+  size_t DynamicMemory(const Node & node);
 }
@@ -1,8 +1,108 @@
 #include "json_reader.h"
 #include "json_builder.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <optional>
+
 using namespace std::literals;
 
+namespace {
+
+#if TRANSPORT_TRACING
+// Trace events keep the name pointer, so it has to be a literal.
+const char* RequestTraceName(const std::string& type){
+    if(type == "Stop") return "Stop";
+    if(type == "Bus") return "Bus";
+    if(type == "Map") return "Map";
+    if(type == "Route") return "Route";
+    if(type == "RouteMatrix") return "RouteMatrix";
+    if(type == "StopSearch") return "StopSearch";
+    return "Unknown";
+}
+
+std::string_view RequestTraceDetail(const json::Dict& info, char (&detail)[trace::DETAIL_SIZE]){
+    auto text = [&info](const char* key) -> const char* {
+        auto it = info.find(key);
+        return it != info.end() && it->second.IsString() ? it->second.AsString().c_str() : "";
+    };
+    auto it = info.find("id"s);
+    const int id = it != info.end() && it->second.IsInt() ? it->second.AsInt() : 0;
+    int length = 0;
+    if(info.count("from"s)){
+        length = std::snprintf(detail, sizeof(detail), "id=%d from=%s to=%s", id, text("from"), text("to"));
+    }
+    else if(info.count("prefix"s) || info.count("query"s)){
+        length = std::snprintf(detail, sizeof(detail), "id=%d prefix=%s query=%s", id, text("prefix"), text("query"));
+    }
+    else{
+        length = std::snprintf(detail, sizeof(detail), "id=%d name=%s", id, text("name"));
+    }
+    return {detail, std::min<size_t>(std::max(length, 0), sizeof(detail) - 1)};
+}
+#endif
+
+void PrintIndent(std::ostream& output, int indent){
+    for(int i = 0; i < indent; ++i){
+        output.put(' ');
+    }
+}
+
+const int MAX_STOP_SEARCH_DISTANCE = 3;
+
+// Sizes and counts in settings and requests; a negative one would otherwise
+// wrap around to a huge size_t.
+size_t ReadCount(const json::Dict& request, const std::string& key){
+    const int value = request.at(key).AsInt();
+    if(value < 0){
+        throw std::invalid_argument(key + " must not be negative"s);
+    }
+    return static_cast<size_t>(value);
+}
+
+// A Route request may override bus_wait_time and bus_velocity, for example
+// for a slower walking profile; whatever it leaves out comes from
+// routing_settings.
+std::optional<router::RouteView> FindRequestedRoute(const json::Dict& info, const router::TransportRouter& router,
+                                                    const transport::Stop* from, const transport::Stop* to){
+    if(!info.count("bus_wait_time"s) && !info.count("bus_velocity"s)){
+        return router.FindRoute(from, to);
+    }
+    const router::RoutingSettings settings = router.GetSettings();
+    router::TimeSettings time_settings{settings.bus_wait_time, settings.bus_velocity};
+    if(info.count("bus_wait_time"s)){
+        time_settings.bus_wait_time = info.at("bus_wait_time"s).AsInt();
+    }
+    if(info.count("bus_velocity"s)){
+        time_settings.bus_velocity = info.at("bus_velocity"s).AsDouble();
+    }
+    if(time_settings.bus_wait_time < 0 || !(time_settings.bus_velocity > 0.0)){
+        throw std::invalid_argument("bus_wait_time must not be negative and bus_velocity must be positive");
+    }
+    return router.FindRoute(from, to, time_settings);
+}
+
+}
+
+JSONReader::JSONReader(PipelinedLoader& loader)
+:input_(loader.TakeDocument()), format_(Format::JSON){}
+
+json::Document JSONReader::LoadDocument(std::istream& input, Format format){
+    METRICS_SCOPE(metrics::Phase::JSON_LOAD);
+    TRACE_SCOPE("json_load", "pipeline");
+    if(format == Format::MESSAGE_PACK){
+        return msgpack::Load(input);
+    }
+    return json::Load(input);
+}
+
+memory::Usage JSONReader::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("document", memory::TotalMemory(input_.GetRoot()));
+    return usage;
+}
+
 const json::Node& JSONReader::GetBaseRequest(){
     if (!input_.GetRoot().AsMap().count("base_requests"s)) return value_;
     return input_.GetRoot().AsMap().at("base_requests"s);
@@ -27,43 +127,66 @@ const json::Node& JSONReader::GetRoutingSettings(){
 }
 
 void JSONReader::ParseCatalogue(transport::TransportCatalogue& catalogue) {
-    json::Array requests = GetBaseRequest().AsArray();
+    METRICS_SCOPE(metrics::Phase::PARSE_CATALOGUE);
+    TRACE_SCOPE("parse_catalogue", "pipeline");
+    const json::Array& requests = GetBaseRequest().AsArray();
     for(auto& request : requests){
-        json::Dict info = request.AsMap();
-        if(info.at("type"s).AsString() == "Stop"s){
-            std::string stop_name = info.at("name"s).AsString();
-            geo::Coordinates coordinates = {info.at("latitude"s).AsDouble(), info.at("longitude"s).AsDouble()};
-            catalogue.AddStop(stop_name, coordinates);
+        if(request.AsMap().at("type"s).AsString() == "Stop"s){
+            AddStop(request.AsMap(), catalogue);
         }
     }
     for(auto& request : requests){
-        json::Dict info = request.AsMap();
-        if(info.at("type"s).AsString() == "Stop"s){
-            std::string stop_name = info.at("name"s).AsString();
-            std::map<std::string_view, int> distances;
-            for(auto& [name, dist] : info.at("road_distances"s).AsMap()){
-                distances.emplace(name, dist.AsInt());
-        }
-        for(auto& [name, dist] : distances){
-            transport::Stop* from = catalogue.FindStop(stop_name);
-            transport::Stop* to = catalogue.FindStop(name);
-            auto dist_pair = std::make_pair(from, to);
-            catalogue.AddDistance(dist_pair, dist);   
+        if(request.AsMap().at("type"s).AsString() == "Stop"s){
+            AddStopDistances(request.AsMap(), catalogue);
         }
     }
- }
     for(auto& request : requests){
-        json::Dict info = request.AsMap();
-        if(info.at("type"s).AsString() == "Bus"){
-            std::string bus_name = info.at("name"s).AsString();
-            bool is_roundtrip = info.at("is_roundtrip").AsBool();
-            std::vector<transport::Stop*> stops;
-            for(auto& name : info.at("stops"s).AsArray()){
-                stops.push_back(catalogue.FindStop(name.AsString()));
-            }
-            catalogue.AddBus(bus_name, stops, is_roundtrip);
+        if(request.AsMap().at("type"s).AsString() == "Bus"s){
+            AddBus(request.AsMap(), catalogue);
         }
     } 
+    catalogue.Finalize();
+}
+
+void JSONReader::AddStop(const json::Dict& info, transport::TransportCatalogue& catalogue) {
+    std::string stop_name = info.at("name"s).AsString();
+    geo::Coordinates coordinates = {info.at("latitude"s).AsDouble(), info.at("longitude"s).AsDouble()};
+    catalogue.AddStop(stop_name, coordinates);
+    METRICS_ADD(metrics::Counter::STOPS, 1);
+}
+
+void JSONReader::AddStopDistances(const json::Dict& info, transport::TransportCatalogue& catalogue) {
+    std::string stop_name = info.at("name"s).AsString();
+    std::map<std::string_view, int> distances;
+    for(auto& [name, dist] : info.at("road_distances"s).AsMap()){
+        distances.emplace(name, dist.AsInt());
+    }
+    for(auto& [name, dist] : distances){
+        transport::Stop* from = catalogue.FindStop(stop_name);
+        transport::Stop* to = catalogue.FindStop(name);
+        auto dist_pair = std::make_pair(from, to);
+        catalogue.AddDistance(dist_pair, dist);   
+    }
+}
+
+void JSONReader::AddBus(const json::Dict& info, transport::TransportCatalogue& catalogue) {
+    std::string bus_name = info.at("name"s).AsString();
+    bool is_roundtrip = info.at("is_roundtrip").AsBool();
+    std::vector<transport::Stop*> stops;
+    for(auto& name : info.at("stops"s).AsArray()){
+        stops.push_back(catalogue.FindStop(name.AsString()));
+    }
+    std::vector<transport::Trip> trips;
+    if(info.count("trips"s)){
+        for(auto& trip : info.at("trips"s).AsArray()){
+            trips.emplace_back();
+            for(auto& time : trip.AsArray()){
+                trips.back().times.push_back(time.AsDouble());
+            }
+        }
+    }
+    catalogue.AddBus(bus_name, stops, is_roundtrip, std::move(trips));
+    METRICS_ADD(metrics::Counter::BUSES, 1);
 }
 
 void JSONReader::ParseFirstPart(renderer::RenderSettings&r_struct, json::Dict& info){
@@ -138,7 +261,7 @@ renderer::RenderSettings JSONReader::ParseRenderSettings(){
 
 
 
-json::Dict JSONReader::CreateDictStop(json::Dict& info, const transport::TransportCatalogue& catalogue){
+json::Dict JSONReader::CreateDictStop(const json::Dict& info, const transport::TransportCatalogue& catalogue){
     json::Dict answer;
     if(info.empty()) throw std::logic_error("info is empty");
     int id = info.at("id"s).AsInt();
@@ -147,7 +270,7 @@ json::Dict JSONReader::CreateDictStop(json::Dict& info, const transport::Transpo
     if(catalogue.FindStop(stop_name)){
         json::Array buses;
         for(const auto& bus : catalogue.BusesForStop(catalogue.FindStop(stop_name))){
-            buses.push_back(bus);
+            buses.push_back(std::string(bus));
     }
         answer = json::Builder{}
             .StartDict()
@@ -172,7 +295,7 @@ json::Dict JSONReader::CreateDictStop(json::Dict& info, const transport::Transpo
     return answer;    
 }
 
-json::Dict JSONReader::CreateDictBus(json::Dict& info, const transport::TransportCatalogue& catalogue){
+json::Dict JSONReader::CreateDictBus(const json::Dict& info, const transport::TransportCatalogue& catalogue){
     if(info.empty()) throw std::logic_error("info is empty");
     json::Dict answer;
     int id = info.at("id"s).AsInt();
@@ -210,78 +333,324 @@ json::Dict JSONReader::CreateDictBus(json::Dict& info, const transport::Transpor
     return answer;
 }
 
-json::Dict JSONReader::CreateRoute(json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue){
-    json::Dict answer;
+void JSONReader::WriteRoute(std::ostream& output, const RouteAnswer& answer){
+    const router::RouteView& route = answer.route;
+    double total_time = 0.0;
+    msgpack::WriteMapHeader(3, output);
+    msgpack::WriteString("items"sv, output);
+    msgpack::WriteArrayHeader(route.GetItemCount() * 2, output);
+    for(size_t i = 0; i < route.GetItemCount(); ++i){
+        const router::RouteItem item = route.GetItem(i);
+        msgpack::WriteMapHeader(3, output);
+        msgpack::WriteString("stop_name"sv, output);
+        msgpack::WriteString(item.stop_wait, output);
+        msgpack::WriteString("time"sv, output);
+        msgpack::WriteInt(item.wait_time, output);
+        msgpack::WriteString("type"sv, output);
+        msgpack::WriteString("Wait"sv, output);
+        msgpack::WriteMapHeader(4, output);
+        msgpack::WriteString("bus"sv, output);
+        msgpack::WriteString(item.bus, output);
+        msgpack::WriteString("span_count"sv, output);
+        msgpack::WriteInt(item.span_count, output);
+        msgpack::WriteString("time"sv, output);
+        msgpack::WriteDouble(item.time, output);
+        msgpack::WriteString("type"sv, output);
+        msgpack::WriteString("Bus"sv, output);
+        total_time += item.time;
+    }
+    msgpack::WriteString("request_id"sv, output);
+    msgpack::WriteInt(answer.id, output);
+    msgpack::WriteString("total_time"sv, output);
+    msgpack::WriteDouble(total_time, output);
+}
+
+JSONReader::Answer JSONReader::AnswerRoute(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue){
+    if(info.count("departure_time"s)){
+        return CreateJourney(info, router, catalogue);
+    }
     int id = info.at("id"s).AsInt();
     auto stop_from = catalogue.FindStop(info.at("from"s).AsString());
-    auto stop_to = catalogue.FindStop(info.at("to").AsString());
-    auto route_info = router.FindRouteInfo(stop_from, stop_to);
-    if(!route_info.has_value()){ 
-        answer = json::Builder{}  
-            .StartDict()  
-                .Key("error_message"s)  
-                .Value("not found"s)  
-                .Key("request_id"s)  
-                .Value(id)  
-            .EndDict()  
-        .Build().AsMap();  
-    }
-    else{  
-        double total_time = 0.0;
-        json::Array items;
-        items.reserve(route_info.value().size());
-        for(auto el : route_info.value()){
-            items.emplace_back(json::Node{json::Builder{}
+    auto stop_to = catalogue.FindStop(info.at("to"s).AsString());
+    if(stop_from && stop_to){
+        if(auto route = FindRequestedRoute(info, router, stop_from, stop_to)){
+            return RouteAnswer{id, std::move(*route)};
+        }
+    }
+    return json::Builder{}
+        .StartDict()
+            .Key("error_message"s)
+            .Value("not found"s)
+            .Key("request_id"s)
+            .Value(id)
+        .EndDict()
+    .Build();
+}
+
+void JSONReader::PrintRoute(std::ostream& output, const RouteAnswer& answer, int indent){
+    const router::RouteView& route = answer.route;
+    double total_time = 0.0;
+    output << "{\n"sv;
+    PrintIndent(output, indent + 4);
+    output << "\"items\": [\n"sv;
+    for(size_t i = 0; i < route.GetItemCount(); ++i){
+        const router::RouteItem item = route.GetItem(i);
+        if(i > 0){
+            output << ",\n"sv;
+        }
+        PrintIndent(output, indent + 8);
+        output << "{\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"stop_name\": "sv;
+        json::PrintString(item.stop_wait, output);
+        output << ",\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"time\": "sv << item.wait_time << ",\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"type\": \"Wait\"\n"sv;
+        PrintIndent(output, indent + 8);
+        output << "},\n"sv;
+        PrintIndent(output, indent + 8);
+        output << "{\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"bus\": "sv;
+        json::PrintString(item.bus, output);
+        output << ",\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"span_count\": "sv << item.span_count << ",\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"time\": "sv << item.time << ",\n"sv;
+        PrintIndent(output, indent + 12);
+        output << "\"type\": \"Bus\"\n"sv;
+        PrintIndent(output, indent + 8);
+        output.put('}');
+        total_time += item.time;
+    }
+    output.put('\n');
+    PrintIndent(output, indent + 4);
+    output << "],\n"sv;
+    PrintIndent(output, indent + 4);
+    output << "\"request_id\": "sv << answer.id << ",\n"sv;
+    PrintIndent(output, indent + 4);
+    output << "\"total_time\": "sv << total_time << '\n';
+    PrintIndent(output, indent);
+    output.put('}');
+}
+
+json::Dict JSONReader::CreateJourney(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue){
+    int id = info.at("id"s).AsInt();
+    auto stop_from = catalogue.FindStop(info.at("from"s).AsString());
+    auto stop_to = catalogue.FindStop(info.at("to"s).AsString());
+    double departure_time = info.at("departure_time"s).AsDouble();
+    std::optional<router::Journey> journey;
+    if(stop_from && stop_to){
+        journey = router.FindJourney(stop_from, stop_to, departure_time);
+    }
+    if(!journey){
+        return json::Builder{}
+            .StartDict()
+                .Key("error_message"s)
+                .Value("not found"s)
+                .Key("request_id"s)
+                .Value(id)
+            .EndDict()
+        .Build().AsMap();
+    }
+    json::Array items;
+    items.reserve(journey->legs.size() * 2);
+    for(const auto& leg : journey->legs){
+        items.emplace_back(json::Builder{}
             .StartDict()
                 .Key("type"s)
                 .Value("Wait"s)
                 .Key("stop_name"s)
-                .Value(el.stop_wait)
+                .Value(std::string(leg.board_stop))
                 .Key("time"s)
-                .Value(el.wait_time)
+                .Value(leg.wait_time)
             .EndDict()
-            .Build().AsMap()});
-                
-            items.emplace_back(json::Node{json::Builder{}
+        .Build());
+        items.emplace_back(json::Builder{}
             .StartDict()
                 .Key("type"s)
                 .Value("Bus"s)
-                .Key("bus")
-                .Value(el.name)
+                .Key("bus"s)
+                .Value(std::string(leg.bus))
                 .Key("span_count"s)
-                .Value(el.span_count)
+                .Value(leg.span_count)
                 .Key("time"s)
-                .Value(el.time)
-            .EndDict().
-            Build().AsMap()});
-            total_time += el.time;
+                .Value(leg.ride_time)
+            .EndDict()
+        .Build());
     }
-        answer = json::Builder{}
+    return json::Builder{}
+        .StartDict()
+            .Key("request_id"s)
+            .Value(id)
+            .Key("departure_time"s)
+            .Value(journey->departure_time)
+            .Key("arrival_time"s)
+            .Value(journey->arrival_time)
+            .Key("total_time"s)
+            .Value(journey->arrival_time - journey->departure_time)
+            .Key("items"s)
+            .Value(items)
+        .EndDict()
+    .Build().AsMap();
+}
+
+json::Dict JSONReader::CreateRouteMatrix(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue){
+    int id = info.at("id"s).AsInt();
+    std::vector<const transport::Stop*> sources;
+    std::vector<const transport::Stop*> targets;
+    bool all_found = true;
+    for(const auto& name : info.at("sources"s).AsArray()){
+        sources.push_back(catalogue.FindStop(name.AsString()));
+        all_found = all_found && sources.back();
+    }
+    for(const auto& name : info.at("targets"s).AsArray()){
+        targets.push_back(catalogue.FindStop(name.AsString()));
+        all_found = all_found && targets.back();
+    }
+    if(!all_found){
+        return json::Builder{}
             .StartDict()
+                .Key("error_message"s)
+                .Value("not found"s)
                 .Key("request_id"s)
                 .Value(id)
-                .Key("total_time"s)
-                .Value(total_time)
-                .Key("items"s)
-                .Value(items)
             .EndDict()
         .Build().AsMap();
-    }   
-    return answer;
     }
 
+    json::Array rows;
+    rows.reserve(sources.size());
+    for(const auto& times : router.ComputeTravelTimes(sources, targets)){
+        json::Array row;
+        row.reserve(times.size());
+        for(const auto& time : times){
+            row.push_back(time ? json::Node{*time} : json::Node{nullptr});
+        }
+        rows.emplace_back(std::move(row));
+    }
+    return json::Builder{}
+        .StartDict()
+            .Key("request_id"s)
+            .Value(id)
+            .Key("total_times"s)
+            .Value(std::move(rows))
+        .EndDict()
+    .Build().AsMap();
+}
+
+json::Dict JSONReader::CreateStopSearch(const json::Dict& info, const transport::TransportCatalogue& catalogue){
+    int id = info.at("id"s).AsInt();
+    const size_t limit = info.count("limit"s) ? ReadCount(info, "limit"s) : 10;
+    json::Array stops;
+    if(info.count("prefix"s)){
+        for(const transport::Stop* stop : catalogue.FindStopsByPrefix(info.at("prefix"s).AsString(), limit)){
+            stops.emplace_back(std::string(stop->stop_name));
+        }
+    }
+    else {
+        // Past a few edits every short name matches, and the search stops
+        // pruning anything.
+        const int max_distance = info.count("max_distance"s) ? info.at("max_distance"s).AsInt() : 1;
+        if(max_distance < 0 || max_distance > MAX_STOP_SEARCH_DISTANCE){
+            throw std::invalid_argument("max_distance must be between 0 and "s + std::to_string(MAX_STOP_SEARCH_DISTANCE));
+        }
+        for(const auto& [stop, distance] : catalogue.FindSimilarStops(info.at("query"s).AsString(), max_distance, limit)){
+            stops.emplace_back(std::string(stop->stop_name));
+        }
+    }
+    return json::Builder{}
+        .StartDict()
+            .Key("request_id"s)
+            .Value(id)
+            .Key("stops"s)
+            .Value(std::move(stops))
+        .EndDict()
+    .Build().AsMap();
+}
+
 router::RoutingSettings JSONReader::FillRoutingSettings(const json::Dict& request) {
         router::RoutingSettings settings;
         settings.bus_wait_time = request.at("bus_wait_time"s).AsInt();
         settings.bus_velocity = request.at("bus_velocity"s).AsDouble();
+        if(request.count("route_cache_capacity"s)){
+            settings.route_cache_capacity = ReadCount(request, "route_cache_capacity"s);
+        }
+        if(request.count("route_cache_admission"s)){
+            settings.route_cache_admission = ReadCount(request, "route_cache_admission"s);
+        }
+        if(request.count("engine"s)){
+            const std::string& engine = request.at("engine"s).AsString();
+            if(engine == "all_pairs"s){
+                settings.engine = router::RouteEngine::ALL_PAIRS;
+            }
+            else if(engine == "blocked_all_pairs"s){
+                settings.engine = router::RouteEngine::BLOCKED_ALL_PAIRS;
+            }
+            else if(engine == "shortest_path_trees"s){
+                settings.engine = router::RouteEngine::SHORTEST_PATH_TREES;
+            }
+            else if(engine == "landmarks"s){
+                settings.engine = router::RouteEngine::LANDMARKS;
+            }
+            else if(engine == "partitioned"s){
+                settings.engine = router::RouteEngine::PARTITIONED;
+            }
+            else {
+                throw std::invalid_argument("unknown routing engine: "s + engine);
+            }
+        }
+        if(request.count("precompute_threads"s)){
+            settings.precompute_threads = ReadCount(request, "precompute_threads"s);
+        }
+        if(request.count("tree_cache_capacity"s)){
+            settings.tree_cache_capacity = ReadCount(request, "tree_cache_capacity"s);
+        }
+        if(request.count("landmark_count"s)){
+            settings.landmark_count = ReadCount(request, "landmark_count"s);
+        }
+        if(request.count("partition_cell_size"s)){
+            settings.partition_cell_size = ReadCount(request, "partition_cell_size"s);
+        }
+        if(request.count("partition_max_boundary_share"s)){
+            settings.partition_max_boundary_share = request.at("partition_max_boundary_share"s).AsDouble();
+            if(!(settings.partition_max_boundary_share >= 0.0 && settings.partition_max_boundary_share <= 1.0)){
+                throw std::invalid_argument("partition_max_boundary_share must be between 0 and 1"s);
+            }
+        }
+        if(request.count("weight_type"s)){
+            const std::string& weight_type = request.at("weight_type"s).AsString();
+            if(weight_type == "minutes"s){
+                settings.weight_type = router::WeightType::MINUTES;
+            }
+            else if(weight_type == "fixed_milliseconds"s){
+                settings.weight_type = router::WeightType::FIXED_MILLISECONDS;
+            }
+            else {
+                throw std::invalid_argument("unknown weight type: "s + weight_type);
+            }
+        }
         return settings;
     }
 
 
-json::Dict JSONReader::CreateMap(json::Dict& info, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& map_renderer){
+json::Dict JSONReader::CreateMap(const json::Dict& info, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& map_renderer){
     if(info.empty()) throw std::logic_error("info is empty");
     json::Dict answer;
-    std::string map = map_renderer.RenderBusesMap(catalogue);
+    std::string map;
+    if(info.count("buses"s)){
+        std::vector<std::string> bus_names;
+        for(const auto& name : info.at("buses"s).AsArray()){
+            bus_names.push_back(name.AsString());
+        }
+        map = map_renderer.RenderBusesMap(catalogue, bus_names);
+    }
+    else {
+        map = map_renderer.RenderBusesMap(catalogue);
+    }
     int id = info.at("id"s).AsInt();
     answer = json::Builder{}
         .StartDict()
@@ -295,24 +664,102 @@ json::Dict JSONReader::CreateMap(json::Dict& info, const transport::TransportCat
 }
 
 
-void JSONReader::MakeAndPrint(json::Array requests, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& map_renderer, const router::TransportRouter& router){
+void JSONReader::MakeAndPrint(const json::Array& requests, const RequestHandler& handler){
     if(requests.empty()) throw std::logic_error("requests are empty");
-    json::Array result;
-    for(auto& request : requests){
-        json::Dict info = request.AsMap();
-        auto type = info.at("type").AsString();
+    const transport::TransportCatalogue& catalogue = handler.GetCatalogue();
+    // Route requests are answered grouped by origin, so that routers keeping
+    // per-origin state reuse it, and the answers are put back in input order.
+    std::vector<size_t> order(requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto route_origin = [&requests](size_t index) -> const std::string* {
+        const json::Dict& info = requests[index].AsMap();
+        if(info.at("type"s).AsString() != "Route"s) return nullptr;
+        return &info.at("from"s).AsString();
+    };
+    std::stable_sort(order.begin(), order.end(), [&route_origin](size_t lhs, size_t rhs){
+        const std::string* lhs_from = route_origin(lhs);
+        const std::string* rhs_from = route_origin(rhs);
+        if(!lhs_from || !rhs_from) return !lhs_from && rhs_from;
+        return *lhs_from < *rhs_from;
+    });
+    std::vector<Answer> answers(requests.size());
+    for(size_t index : order){
+        const json::Dict& info = requests[index].AsMap();
+        const std::string& type = info.at("type").AsString();
+        METRICS_ADD(metrics::Counter::REQUESTS, 1);
+#if TRANSPORT_TRACING
+        char detail[trace::DETAIL_SIZE];
+        TRACE_SCOPE_DETAIL(RequestTraceName(type), "request",
+                           trace::IsEnabled() ? RequestTraceDetail(info, detail) : std::string_view{});
+#endif
+        Answer& answer = answers[index];
         if(type == "Stop"){
-            result.push_back(CreateDictStop(info, catalogue));
+            METRICS_SCOPE(metrics::Phase::STOP_REQUEST);
+            answer = CreateDictStop(info, catalogue);
         }
         if(type == "Bus"){
-            result.push_back(CreateDictBus(info, catalogue));
+            METRICS_SCOPE(metrics::Phase::BUS_REQUEST);
+            answer = CreateDictBus(info, catalogue);
         }
         if(type == "Map"){
-            result.push_back(CreateMap(info, catalogue, map_renderer));
+            METRICS_SCOPE(metrics::Phase::MAP_REQUEST);
+            answer = CreateMap(info, catalogue, handler.GetRenderer());
         }
         if(type == "Route"){
-            result.push_back(CreateRoute(info, router, catalogue));
+            METRICS_SCOPE(metrics::Phase::ROUTE_REQUEST);
+            answer = AnswerRoute(info, handler.GetRouter(), catalogue);
+        }
+        if(type == "RouteMatrix"){
+            METRICS_SCOPE(metrics::Phase::ROUTE_MATRIX_REQUEST);
+            answer = CreateRouteMatrix(info, handler.GetRouter(), catalogue);
+        }
+        if(type == "StopSearch"){
+            METRICS_SCOPE(metrics::Phase::STOP_SEARCH_REQUEST);
+            answer = CreateStopSearch(info, catalogue);
+        }
+#if TRANSPORT_METRICS
+        if(const json::Node* node = std::get_if<json::Node>(&answer); node && node->AsMap().count("error_message"s)){
+            METRICS_ADD(metrics::Counter::NOT_FOUND, 1);
+        }
+#endif
+    }
+    PrintAnswers(answers, std::cout);
+}
+
+void JSONReader::PrintAnswers(const std::vector<Answer>& answers, std::ostream& output) const {
+    if(format_ == Format::MESSAGE_PACK){
+        msgpack::WriteArrayHeader(answers.size() - std::count_if(answers.begin(), answers.end(), [](const Answer& answer){
+            return std::holds_alternative<std::monostate>(answer);
+        }), output);
+        for(const auto& answer : answers){
+            if(const json::Node* node = std::get_if<json::Node>(&answer)){
+                msgpack::Write(*node, output);
+            }
+            else if(const RouteAnswer* route = std::get_if<RouteAnswer>(&answer)){
+                WriteRoute(output, *route);
+            }
+        }
+        return;
+    }
+    // Printed piece by piece with json::Print's layout, so that routes go
+    // straight from the router's edges to the output.
+    output << "[\n"sv;
+    bool first = true;
+    for(const auto& answer : answers){
+        if(std::holds_alternative<std::monostate>(answer)){
+            continue;
+        }
+        if(!first){
+            output << ",\n"sv;
+        }
+        first = false;
+        PrintIndent(output, 4);
+        if(const json::Node* node = std::get_if<json::Node>(&answer)){
+            json::PrintIndented(*node, output, 4);
+        }
+        else{
+            PrintRoute(output, std::get<RouteAnswer>(answer), 4);
         }
     }
-    json::Print(json::Document{result}, std::cout);
+    output << "\n]"sv;
 }
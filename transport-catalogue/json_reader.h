@@ -1,17 +1,31 @@
 #pragma once
 
 #include "json.h"
+#include "msgpack.h"
+#include "pipelined_loader.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "map_renderer.h"
+#include "request_handler.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <iomanip>
 #include <iostream>
+#include <variant>
 
 class JSONReader{
 public:
-  JSONReader(std::istream& input)
-  :input_(json::Load(input)){}
+  // Encoding of both the input document and the printed responses.
+  enum class Format {
+    JSON,
+    MESSAGE_PACK
+  };
+
+  JSONReader(std::istream& input, Format format = Format::JSON)
+  :input_(LoadDocument(input, format)), format_(format){}
+  // Takes the rest of a pipelined document once its catalogue is built.
+  explicit JSONReader(PipelinedLoader& loader);
 
   const json::Node& GetBaseRequest();
   const json::Node& GetStateRequest();
@@ -19,20 +33,45 @@ public:
   const json::Node& GetRoutingSettings();
 
   void ParseCatalogue(transport::TransportCatalogue& catalogue);
+  // One base request each; stops have to be added before distances and buses
+  // that refer to them.
+  static void AddStop(const json::Dict& info, transport::TransportCatalogue& catalogue);
+  static void AddStopDistances(const json::Dict& info, transport::TransportCatalogue& catalogue);
+  static void AddBus(const json::Dict& info, transport::TransportCatalogue& catalogue);
   renderer::RenderSettings ParseRenderSettings();
-  json::Dict CreateDictStop(json::Dict& info, const transport::TransportCatalogue& catalogue);
-  json::Dict CreateDictBus(json::Dict& info, const transport::TransportCatalogue& catalogue);
-  json::Dict CreateRoute(json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue);
-  json::Dict CreateMap(json::Dict& info, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& renderer);
-  router::RoutingSettings FillRoutingSettings(const json::Dict& request);
-  void MakeAndPrint(json::Array requests, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& map_renderer, const router::TransportRouter& router);
+  json::Dict CreateDictStop(const json::Dict& info, const transport::TransportCatalogue& catalogue);
+  json::Dict CreateDictBus(const json::Dict& info, const transport::TransportCatalogue& catalogue);
+  json::Dict CreateJourney(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue);
+  json::Dict CreateRouteMatrix(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue);
+  json::Dict CreateMap(const json::Dict& info, const transport::TransportCatalogue& catalogue, const renderer::MapRenderer& renderer);
+  // "prefix" lists stops whose names start with it; otherwise "query" lists
+  // stops within "max_distance" edits of it (0 to 3, default 1). Up to
+  // "limit" stops, 10 by default. Out-of-range values throw
+  // std::invalid_argument.
+  json::Dict CreateStopSearch(const json::Dict& info, const transport::TransportCatalogue& catalogue);
+  static router::RoutingSettings FillRoutingSettings(const json::Dict& request);
+  memory::Usage GetMemoryUsage() const;
+  void MakeAndPrint(const json::Array& requests, const RequestHandler& handler);
 
 private:
+  struct RouteAnswer {
+    int id;
+    router::RouteView route;
+  };
+  // Empty for requests of unknown type, which get no answer.
+  using Answer = std::variant<std::monostate, json::Node, RouteAnswer>;
+
+  static json::Document LoadDocument(std::istream& input, Format format);
+  Answer AnswerRoute(const json::Dict& info, const router::TransportRouter& router, const transport::TransportCatalogue& catalogue);
+  static void PrintRoute(std::ostream& output, const RouteAnswer& answer, int indent);
+  static void WriteRoute(std::ostream& output, const RouteAnswer& answer);
+  void PrintAnswers(const std::vector<Answer>& answers, std::ostream& output) const;
 
   void ParseFirstPart(renderer::RenderSettings& r_struct, json::Dict& info);
   void ParseLabels(renderer::RenderSettings& r_struct, json::Dict& info)ж
   void ParseUnderlayer(renderer::RenderSettings& r_struct, json::Dict& info);
   void ParsePalette(renderer::RenderSettings& r_struct, json::Dict& info);
   json::Document input_;
+  Format format_;
   json::Node value_ = nullptr;
 };
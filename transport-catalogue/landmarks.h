@@ -0,0 +1,219 @@
+#pragma once
+
+#include "graph.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <limits>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Distance tables for ALT search (A*, landmarks, triangle inequality). For
+// any landmark L, d(L, to) - d(L, from) and d(from, L) - d(to, L) are lower
+// bounds on d(from, to). Unlike straight-line bounds they follow the road
+// distances, so they stay tight where the network bends around obstacles.
+// Landmarks are picked farthest-first: each one is the vertex farthest from
+// those already picked, and a vertex none of them reaches counts as farthest,
+// so every component gets a landmark.
+template <typename Weight>
+class Landmarks {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+
+    Landmarks(const Graph& graph, size_t landmark_count, size_t threads = 0);
+
+    // INFINITE_WEIGHT when to is known to be unreachable from from.
+    Weight GetLowerBound(VertexId from, VertexId to) const;
+    const std::vector<VertexId>& GetLandmarks() const;
+    memory::Usage GetMemoryUsage() const;
+
+private:
+    // Edges leaving each vertex of the reversed graph, as ids into graph's
+    // edges, in one flat array indexed through offsets.
+    struct ReverseGraph {
+        std::vector<size_t> offsets;
+        std::vector<EdgeId> edges;
+    };
+
+    std::vector<Weight> ComputeDistances(VertexId source, const ReverseGraph* reverse) const;
+    void StoreColumn(std::vector<Weight>& table, size_t column, const std::vector<Weight>& distances) const;
+
+    const Graph& graph_;
+    std::vector<VertexId> landmarks_;
+    // Vertex-major, so the bounds for one vertex share a cache line or two:
+    // entry vertex * landmark count + i refers to landmarks_[i].
+    std::vector<Weight> from_landmarks_;
+    std::vector<Weight> to_landmarks_;
+};
+
+template <typename Weight>
+Landmarks<Weight>::Landmarks(const Graph& graph, size_t landmark_count, size_t threads)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    ReverseGraph reverse;
+    reverse.offsets.assign(vertex_count + 1, 0);
+    std::vector<bool> has_edges(vertex_count, false);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        ++reverse.offsets[edge.to + 1];
+        has_edges[edge.from] = has_edges[edge.to] = true;
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        reverse.offsets[vertex + 1] += reverse.offsets[vertex];
+    }
+    reverse.edges.resize(graph.GetEdgeCount());
+    std::vector<size_t> fill(reverse.offsets.begin(), reverse.offsets.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        reverse.edges[fill[graph.GetEdge(edge_id).to]++] = edge_id;
+    }
+
+    // Picking is sequential, since every landmark depends on the distances
+    // from the previous ones; those distances are the forward table.
+    std::vector<std::vector<Weight>> forward;
+    std::vector<Weight> nearest(vertex_count, INFINITE_WEIGHT);
+    const auto first = std::find(has_edges.begin(), has_edges.end(), true);
+    if (first != has_edges.end()) {
+        const std::vector<Weight> start = ComputeDistances(first - has_edges.begin(), nullptr);
+        VertexId farthest = first - has_edges.begin();
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            if (start[vertex] != INFINITE_WEIGHT && start[vertex] > start[farthest]) {
+                farthest = vertex;
+            }
+        }
+        while (landmarks_.size() < std::min(landmark_count, vertex_count)) {
+            landmarks_.push_back(farthest);
+            forward.push_back(ComputeDistances(farthest, nullptr));
+            nearest[farthest] = Weight{};
+            bool found = false;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                nearest[vertex] = std::min(nearest[vertex], forward.back()[vertex]);
+                if (has_edges[vertex] && nearest[vertex] > Weight{} && (!found || nearest[vertex] > nearest[farthest])) {
+                    farthest = vertex;
+                    found = true;
+                }
+            }
+            if (!found) {
+                break;
+            }
+        }
+    }
+
+    const size_t count = landmarks_.size();
+    from_landmarks_.resize(vertex_count * count);
+    to_landmarks_.resize(vertex_count * count);
+    for (size_t i = 0; i < count; ++i) {
+        StoreColumn(from_landmarks_, i, forward[i]);
+    }
+    forward.clear();
+
+    auto compute_columns = [this, &reverse, count](size_t worker, size_t workers) {
+        for (size_t i = worker; i < count; i += workers) {
+            StoreColumn(to_landmarks_, i, ComputeDistances(landmarks_[i], &reverse));
+        }
+    };
+    const size_t workers = std::min(count, threads ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> tasks;
+    for (size_t worker = 1; worker < workers; ++worker) {
+        tasks.push_back(std::async(std::launch::async, compute_columns, worker, workers));
+    }
+    compute_columns(0, std::max<size_t>(workers, 1));
+    for (auto& task : tasks) {
+        task.get();
+    }
+}
+
+template <typename Weight>
+std::vector<Weight> Landmarks<Weight>::ComputeDistances(VertexId source, const ReverseGraph* reverse) const {
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::vector<Weight> distances(graph_.GetVertexCount(), INFINITE_WEIGHT);
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    distances[source] = Weight{};
+    queue.push({Weight{}, source});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > distances[vertex]) {
+            continue;
+        }
+        auto relax = [&distances, &queue, weight = weight](VertexId next, Weight edge_weight) {
+            if (weight + edge_weight < distances[next]) {
+                distances[next] = weight + edge_weight;
+                queue.push({distances[next], next});
+            }
+        };
+        if (reverse) {
+            for (size_t i = reverse->offsets[vertex]; i < reverse->offsets[vertex + 1]; ++i) {
+                const auto& edge = graph_.GetEdge(reverse->edges[i]);
+                relax(edge.from, edge.weight);
+            }
+        }
+        else {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                relax(edge.to, edge.weight);
+            }
+        }
+    }
+    return distances;
+}
+
+template <typename Weight>
+void Landmarks<Weight>::StoreColumn(std::vector<Weight>& table, size_t column, const std::vector<Weight>& distances) const {
+    for (VertexId vertex = 0; vertex < distances.size(); ++vertex) {
+        table[vertex * landmarks_.size() + column] = distances[vertex];
+    }
+}
+
+template <typename Weight>
+Weight Landmarks<Weight>::GetLowerBound(VertexId from, VertexId to) const {
+    const size_t count = landmarks_.size();
+    const Weight* from_landmark_to_from = from_landmarks_.data() + from * count;
+    const Weight* from_landmark_to_to = from_landmarks_.data() + to * count;
+    const Weight* from_from_to_landmark = to_landmarks_.data() + from * count;
+    const Weight* from_to_to_landmark = to_landmarks_.data() + to * count;
+    Weight bound{};
+    for (size_t i = 0; i < count; ++i) {
+        if (from_landmark_to_from[i] != INFINITE_WEIGHT) {
+            // A landmark reaching from but not to proves to unreachable.
+            if (from_landmark_to_to[i] == INFINITE_WEIGHT) {
+                return INFINITE_WEIGHT;
+            }
+            // Differences are only taken when positive, so that unsigned
+            // weights do not wrap around.
+            if (from_landmark_to_to[i] > from_landmark_to_from[i]) {
+                bound = std::max(bound, from_landmark_to_to[i] - from_landmark_to_from[i]);
+            }
+        }
+        if (from_from_to_landmark[i] != INFINITE_WEIGHT && from_to_to_landmark[i] != INFINITE_WEIGHT
+            && from_from_to_landmark[i] > from_to_to_landmark[i]) {
+            bound = std::max(bound, from_from_to_landmark[i] - from_to_to_landmark[i]);
+        }
+    }
+    return bound;
+}
+
+template <typename Weight>
+const std::vector<VertexId>& Landmarks<Weight>::GetLandmarks() const {
+    return landmarks_;
+}
+
+template <typename Weight>
+memory::Usage Landmarks<Weight>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("landmarks", memory::TotalMemory(landmarks_));
+    usage.Add("from_landmarks", memory::TotalMemory(from_landmarks_));
+    usage.Add("to_landmarks", memory::TotalMemory(to_landmarks_));
+    return usage;
+}
+
+}  // namespace graph
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cache {
+
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t rejected = 0;
+    size_t evictions = 0;
+};
+
+// Bounded LRU split into independently locked shards, so concurrent lookups of
+// different keys rarely contend. A key is only admitted once it has been
+// offered admission_threshold times, which keeps one-off keys from pushing
+// hot ones out.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity, size_t admission_threshold = 1, size_t shard_count = 16);
+
+    std::optional<Value> Find(const Key& key);
+    void Insert(const Key& key, Value value);
+    void Clear();
+    CacheStats GetStats() const;
+    size_t GetCapacity() const;
+
+private:
+    using Item = std::pair<Key, Value>;
+
+    struct Shard {
+        size_t capacity = 0;
+        std::mutex mutex;
+        std::list<Item> items;
+        std::unordered_map<Key, typename std::list<Item>::iterator, Hash> index;
+        std::unordered_map<Key, size_t, Hash> frequency;
+    };
+
+    Shard& GetShard(const Key& key);
+
+    size_t capacity_;
+    size_t admission_threshold_;
+    Hash hasher_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> rejected_{0};
+    std::atomic<size_t> evictions_{0};
+};
+
+template <typename Key, typename Value, typename Hash>
+LruCache<Key, Value, Hash>::LruCache(size_t capacity, size_t admission_threshold, size_t shard_count)
+    : capacity_(capacity)
+    , admission_threshold_(admission_threshold)
+{
+    // No more shards than entries, and the remainder of capacity spread one
+    // entry each over the first shards, so the shards add up to capacity
+    // exactly.
+    shard_count = std::max<size_t>(std::min(shard_count, capacity), 1);
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+        shards_.back()->capacity = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+typename LruCache<Key, Value, Hash>::Shard& LruCache<Key, Value, Hash>::GetShard(const Key& key) {
+    return *shards_[hasher_(key) % shards_.size()];
+}
+
+template <typename Key, typename Value, typename Hash>
+std::optional<Value> LruCache<Key, Value, Hash>::Find(const Key& key) {
+    if (capacity_ == 0) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    shard.items.splice(shard.items.begin(), shard.items, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+}
+
+template <typename Key, typename Value, typename Hash>
+void LruCache<Key, Value, Hash>::Insert(const Key& key, Value value) {
+    if (capacity_ == 0) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        it->second->second = std::move(value);
+        shard.items.splice(shard.items.begin(), shard.items, it->second);
+        return;
+    }
+    if (admission_threshold_ > 1) {
+        // The frequency sketch is bounded too: once it outgrows the shard it
+        // is reset, which also ages out keys that stopped being hot.
+        if (shard.frequency.size() >= shard.capacity * 4) {
+            shard.frequency.clear();
+        }
+        if (++shard.frequency[key] < admission_threshold_) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        shard.frequency.erase(key);
+    }
+    shard.items.emplace_front(key, std::move(value));
+    shard.index[key] = shard.items.begin();
+    if (shard.items.size() > shard.capacity) {
+        shard.index.erase(shard.items.back().first);
+        shard.items.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+void LruCache<Key, Value, Hash>::Clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard lock(shard->mutex);
+        shard->items.clear();
+        shard->index.clear();
+        shard->frequency.clear();
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+CacheStats LruCache<Key, Value, Hash>::GetStats() const {
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+            rejected_.load(std::memory_order_relaxed), evictions_.load(std::memory_order_relaxed)};
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t LruCache<Key, Value, Hash>::GetCapacity() const {
+    return capacity_;
+}
+
+}  // namespace cache
@@ -1,14 +1,130 @@
 #include "json_reader.h" 
+#include "metrics.h" 
+#include "pipelined_loader.h" 
+#include "trace.h" 
 #include "transport_catalogue.h" 
 
- int main() { 
-   JSONReader json_input(std::cin); 
-    transport::TransportCatalogue catalogue; 
-    json_input.ParseCatalogue(catalogue); 
-    renderer::RenderSettings r_struct = json_input.ParseRenderSettings(); 
-    router::RoutingSettings route_settings = json_input.FillRoutingSettings(json_input.GetRoutingSettings().AsMap());
-    const renderer::MapRenderer map_renderer{r_struct}; 
-    const router::TransportRouter router{catalogue, route_settings};
-    json::Array requests = json_input.GetStateRequest().AsArray(); 
-    json_input.MakeAndPrint(requests, catalogue, map_renderer, router); 
+#include <fstream> 
+#include <memory_resource> 
+#include <optional> 
+#include <string> 
+
+ int main(int argc, char* argv[]) { 
+    // --metrics dumps per-phase timings and counters to stderr at exit,
+    // --metrics=FILE writes them to FILE instead.
+    // --memory-report does the same for the bytes held by each subsystem.
+    std::string metrics_path; 
+    bool dump_metrics = false; 
+    std::string memory_path; 
+    bool report_memory = false; 
+    // --trace=FILE records pipeline stages and requests as Chrome trace JSON.
+    std::string trace_path; 
+    // --pipeline builds the catalogue and the router while the input is
+    // still being parsed. The router is then built even if no request
+    // needs it.
+    bool pipelined = false; 
+    // --format=msgpack reads the input and writes the responses as
+    // MessagePack instead of JSON text; --pipeline only applies to JSON.
+    JSONReader::Format format = JSONReader::Format::JSON; 
+    for (int i = 1; i < argc; ++i) { 
+      const std::string arg = argv[i]; 
+      if (arg == "--metrics") dump_metrics = true; 
+      else if (arg.rfind("--metrics=", 0) == 0) { 
+        dump_metrics = true; 
+        metrics_path = arg.substr(10); 
+      } 
+      else if (arg.rfind("--trace=", 0) == 0) { 
+        trace_path = arg.substr(8); 
+        trace::Enable(); 
+      } 
+      else if (arg == "--pipeline") pipelined = true; 
+      else if (arg == "--format=json") format = JSONReader::Format::JSON; 
+      else if (arg == "--format=msgpack") format = JSONReader::Format::MESSAGE_PACK; 
+      else if (arg.rfind("--format=", 0) == 0) { 
+        std::cerr << "unknown format: " << arg.substr(9) << std::endl; 
+        return 1; 
+      } 
+      else if (arg == "--memory-report") report_memory = true; 
+      else if (arg.rfind("--memory-report=", 0) == 0) { 
+        report_memory = true; 
+        memory_path = arg.substr(16); 
+      } 
+    } 
+
+    // The catalogue lives until exit, so its stops, buses and distances are
+    // bump-allocated and never freed one by one.
+    std::pmr::monotonic_buffer_resource catalogue_arena; 
+    transport::TransportCatalogue catalogue{&catalogue_arena}; 
+    std::optional<JSONReader> json_input; 
+    std::optional<PipelinedLoader> loader; 
+    if (pipelined && format == JSONReader::Format::JSON) { 
+      loader.emplace(std::cin); 
+      loader->BuildCatalogue(catalogue); 
+    } 
+    else { 
+      json_input.emplace(std::cin, format); 
+      json_input->ParseCatalogue(catalogue); 
+    } 
+    // The router and the renderer are built on the first request needing them.
+    json::Node pipelined_routing_settings; 
+    RequestHandler handler{catalogue, 
+      [&json_input] { 
+        TRACE_SCOPE("render_settings", "pipeline"); 
+        return json_input->ParseRenderSettings(); 
+      }, 
+      [&json_input, &loader, &pipelined_routing_settings] { 
+        const json::Node& settings = loader ? pipelined_routing_settings : json_input->GetRoutingSettings(); 
+        return JSONReader::FillRoutingSettings(settings.AsMap()); 
+      }}; 
+    if (loader) { 
+      // Router preprocessing overlaps with parsing whatever follows
+      // routing_settings, usually the stat requests.
+      pipelined_routing_settings = loader->WaitForValue("routing_settings"); 
+      handler.PrepareRouter(); 
+      json_input.emplace(*loader); 
+    } 
+    const json::Array& requests = json_input->GetStateRequest().AsArray(); 
+    { 
+      TRACE_SCOPE("stat_requests", "pipeline"); 
+      json_input->MakeAndPrint(requests, handler); 
+    } 
+
+    if (report_memory) { 
+      std::ofstream file; 
+      if (!memory_path.empty()) file.open(memory_path); 
+      std::ostream& out = memory_path.empty() ? std::cerr : file; 
+      out << "{\n  \"json_document\": "; 
+      memory::PrintUsage(out, json_input->GetMemoryUsage()); 
+      out << ",\n  \"catalogue\": "; 
+      memory::PrintUsage(out, catalogue.GetMemoryUsage()); 
+      if (const router::TransportRouter* router = handler.FindRouter()) { 
+        out << ",\n  \"router\": "; 
+        memory::PrintUsage(out, router->GetMemoryUsage()); 
+      } 
+      out << "\n}" << std::endl; 
+    } 
+
+    if (!trace_path.empty()) { 
+      std::ofstream out(trace_path); 
+      trace::WriteChromeTrace(out); 
+    } 
+
+    if (dump_metrics) { 
+      // The route cache keeps its own counters; they are copied in once,
+      // so the lookups themselves pay for no second set of atomics.
+      if (const router::TransportRouter* router = handler.FindRouter()) { 
+        const cache::CacheStats stats = router->GetRouteCacheStats(); 
+        METRICS_ADD(metrics::Counter::ROUTE_CACHE_HITS, stats.hits); 
+        METRICS_ADD(metrics::Counter::ROUTE_CACHE_MISSES, stats.misses); 
+        METRICS_ADD(metrics::Counter::ROUTE_CACHE_REJECTED, stats.rejected); 
+        METRICS_ADD(metrics::Counter::ROUTE_CACHE_EVICTIONS, stats.evictions); 
+      } 
+      if (metrics_path.empty()) { 
+        metrics::Dump(std::cerr); 
+      } 
+      else { 
+        std::ofstream out(metrics_path); 
+        metrics::Dump(out); 
+      } 
+    } 
   } 
@@ -1,179 +1,362 @@
 #include "map_renderer.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <future>
+#include <set>
+#include <thread>
 
 namespace renderer {
 
-  const RenderSettings MapRenderer::GetSettings() const {
-    return render_settings_;
-  }
+  namespace {
 
-  std::vector <svg::Polyline> MapRenderer::CreateBusLine(std::map <std::string_view, const transport::Bus*> buses, renderer::SphereProjector &projector) const {
-    std::vector <svg::Polyline> result;
-    int number = 0;
-    for (const auto & [name, bus]: buses) {
-      if (bus -> stops.empty()) continue;
-      svg::Polyline line;
-      std::vector <const transport::Stop*> all_stops {bus -> stops.begin(), bus -> stops.end()};
-      if (bus -> is_roundtrip == false) all_stops.insert(all_stops.end(), std::next(bus -> stops.rbegin()), bus -> stops.rend());
-      for (const auto& stop : all_stops) {
-        line.AddPoint(projector(stop -> coordinates));
-      }
+    template <typename Object>
+    void RenderFragment(std::ostream& out, const Object& object) {
+      object.Render(svg::RenderContext{out, 2, 2});
+    }
 
-      line.SetStrokeColor(render_settings_.color_palette[number]);
-      line.SetFillColor("none");
-      line.SetStrokeWidth(render_settings_.line_width);
-      line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-      line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    bool SamePoint(svg::Point lhs, svg::Point rhs) {
+      return lhs.x == rhs.x && lhs.y == rhs.y;
+    }
 
-      if (static_cast <size_t> (number) < render_settings_.color_palette.size() - 1) number++;
-      else number = 0;
-      result.push_back(line);
+    // Colors have no equality of their own; two that print the same draw
+    // the same.
+    bool SameColor(const svg::Color& lhs, const svg::Color& rhs) {
+      std::ostringstream left;
+      std::ostringstream right;
+      left << lhs;
+      right << rhs;
+      return left.str() == right.str();
     }
-    return result;
-  }
 
-  std::vector <svg::Text> MapRenderer::CreateBusName(std::map < std::string_view, const transport::Bus*> & buses, renderer::SphereProjector & projector) const {
-    std::vector <svg::Text> result;
-    svg::Text name;
-    svg::Text underlayer;
-    int number = 0;
-    for (const auto& [bus_name, bus] : buses) {
-      if (bus -> stops.empty()) continue;
-      name.SetPosition(projector(bus -> stops[0] -> coordinates));
-      name.SetOffset(render_settings_.bus_label_offset);
-      name.SetFontSize(render_settings_.bus_label_font_size);
-      name.SetFontFamily("Verdana");
-      name.SetFontWeight("bold");
-      name.SetData(bus -> bus_name);
-      name.SetFillColor(render_settings_.color_palette[number]);
-
-      underlayer.SetPosition(projector(bus -> stops[0] -> coordinates));
-      underlayer.SetOffset(render_settings_.bus_label_offset);
-      underlayer.SetFontSize(render_settings_.bus_label_font_size);
-      underlayer.SetFontFamily("Verdana");
-      underlayer.SetFontWeight("bold");
-      underlayer.SetData(bus -> bus_name);
-      underlayer.SetFillColor(render_settings_.underlayer_color);
-      underlayer.SetStrokeColor(render_settings_.underlayer_color);
-      underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-      underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-      underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-      result.push_back(underlayer);
-      result.push_back(name);
-      
-      if (bus -> is_roundtrip == false) {
-        if (bus -> stops[0] != bus -> stops[bus -> stops.size() - 1]) {
-          svg::Text second_name {name};
-          second_name.SetPosition(projector(bus -> stops[bus -> stops.size() - 1] -> coordinates));
-
-          svg::Text second_underlayer {underlayer};
-          second_underlayer.SetPosition(projector(bus -> stops[bus -> stops.size() - 1] -> coordinates));
-          result.push_back(second_underlayer);
-          result.push_back(second_name);
-        }
-      }
-      if (static_cast < size_t > (number) < render_settings_.color_palette.size() - 1) number++;
-      else number = 0;
+    bool SameSettings(const RenderSettings& lhs, const RenderSettings& rhs) {
+      return lhs.width == rhs.width && lhs.height == rhs.height && lhs.padding == rhs.padding
+        && lhs.line_width == rhs.line_width && lhs.stop_radius == rhs.stop_radius
+        && lhs.bus_label_font_size == rhs.bus_label_font_size && SamePoint(lhs.bus_label_offset, rhs.bus_label_offset)
+        && lhs.stop_label_font_size == rhs.stop_label_font_size && SamePoint(lhs.stop_label_offset, rhs.stop_label_offset)
+        && SameColor(lhs.underlayer_color, rhs.underlayer_color) && lhs.underlayer_width == rhs.underlayer_width
+        && std::equal(lhs.color_palette.begin(), lhs.color_palette.end(), rhs.color_palette.begin(), rhs.color_palette.end(), SameColor);
     }
-    return result;
-  }
 
-  std::vector < svg::Circle > MapRenderer::CreateStopCircles(std::map < std::string_view, const transport::Bus * > & buses, renderer::SphereProjector & projector) const {
-    std::vector < svg::Circle > result;
-    std::map < std::string_view, const transport::Stop*> stops;
-    for (const auto& [name, bus] : buses) {
-      for (const auto& stop : bus -> stops) {
-        stops[stop -> stop_name] = stop;
+    size_t Fingerprint(const ProjectedBus& bus) {
+      const transport::Bus& route = *bus.bus;
+      // A linear route with distinct ends is labelled at both.
+      const bool two_labels = !route.is_roundtrip && route.stops.front() != route.stops.back();
+      size_t fingerprint = std::hash <size_t>()(bus.color_index) * 37 + std::hash <bool>()(route.is_roundtrip);
+      fingerprint = fingerprint * 37 + std::hash <bool>()(two_labels);
+      for (svg::Point point : bus.points) {
+        fingerprint = fingerprint * 37 + std::hash <double>()(point.x);
+        fingerprint = fingerprint * 37 + std::hash <double>()(point.y);
       }
+      return fingerprint;
     }
-    for (const auto& [name, stop] : stops) {
-      svg::Circle circle;
-      circle.SetCenter(projector(stop -> coordinates));
-      circle.SetRadius(render_settings_.stop_radius);
-      circle.SetFillColor("white");
-      result.push_back(circle);
+
+    template <typename Function>
+    void ParallelFor(size_t count, Function function) {
+      const size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+      if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) function(i);
+        return;
+      }
+      const size_t chunk = (count + threads - 1) / threads;
+      std::vector <std::future <void>> tasks;
+      for (size_t begin = chunk; begin < count; begin += chunk) {
+        tasks.push_back(std::async(std::launch::async, [&function, begin, end = std::min(count, begin + chunk)] {
+          TRACE_SCOPE("render_fragments", "render");
+          for (size_t i = begin; i < end; ++i) function(i);
+        }));
+      }
+      for (size_t i = 0; i < std::min(count, chunk); ++i) function(i);
+      for (auto& task : tasks) task.get();
     }
-    return result;
+
   }
 
-  std::vector <svg::Text> MapRenderer::CreateStopName(std::map <std::string_view, const transport::Bus*> & buses, renderer::SphereProjector& projector) const {
-    std::vector <svg::Text> result;
-    svg::Text name;
-    svg::Text underlayer;
-    std::map <std::string_view, const transport::Stop*> stops;
-    for (const auto& [name, bus] : buses) {
-      for (const auto& stop : bus -> stops) {
-        stops[stop -> stop_name] = stop;
-      }
+  FragmentCache::FragmentCache(const RenderSettings& settings)
+    : settings_(settings) {}
+
+  bool FragmentCache::IsFor(const RenderSettings& settings) const {
+    return SameSettings(settings_, settings);
+  }
+
+  std::shared_ptr <const BusFragments> FragmentCache::FindBus(const ProjectorState& state, const ProjectedBus& bus) const {
+    // Keys outlive the catalogue the names come from, so they are copied
+    // out of its resource, before taking the lock.
+    const std::string name(bus.bus -> bus_name);
+    std::lock_guard lock(mutex_);
+    if (state != state_) return nullptr;
+    auto it = buses_.find(name);
+    if (it == buses_.end() || it -> second.fingerprint != bus.fingerprint) {
+      return nullptr;
     }
-    for (const auto& [stop_name, stop]: stops) {
-      name.SetPosition(projector(stop -> coordinates));
-      name.SetOffset(render_settings_.stop_label_offset);
-      name.SetFontSize(render_settings_.stop_label_font_size);
-      name.SetFontFamily("Verdana");
-      name.SetData(stop -> stop_name);
-      name.SetFillColor("black");
-
-      underlayer.SetPosition(projector(stop -> coordinates));
-      underlayer.SetOffset(render_settings_.stop_label_offset);
-      underlayer.SetFontSize(render_settings_.stop_label_font_size);
-      underlayer.SetFontFamily("Verdana");
-      underlayer.SetData(stop -> stop_name);
-      underlayer.SetFillColor(render_settings_.underlayer_color);
-      underlayer.SetStrokeColor(render_settings_.underlayer_color);
-      underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-      underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-      underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-      result.push_back(underlayer);
-      result.push_back(name);
+    return it -> second.fragments;
+  }
 
+  std::shared_ptr <const StopFragments> FragmentCache::FindStop(const ProjectorState& state, const ProjectedStop& stop) const {
+    const std::string name(stop.stop -> stop_name);
+    std::lock_guard lock(mutex_);
+    if (state != state_) return nullptr;
+    auto it = stops_.find(name);
+    if (it == stops_.end() || !SamePoint(it -> second.point, stop.point)) {
+      return nullptr;
     }
-    return result;
+    return it -> second.fragments;
+  }
+
+  void FragmentCache::Store(const ProjectorState& state, const ProjectedBus& bus, std::shared_ptr <const BusFragments> fragments) {
+    std::string name(bus.bus -> bus_name);
+    std::lock_guard lock(mutex_);
+    Reset(state);
+    buses_[std::move(name)] = {bus.fingerprint, std::move(fragments)};
+  }
+
+  void FragmentCache::Store(const ProjectorState& state, const ProjectedStop& stop, std::shared_ptr <const StopFragments> fragments) {
+    std::string name(stop.stop -> stop_name);
+    std::lock_guard lock(mutex_);
+    Reset(state);
+    stops_[std::move(name)] = {stop.point, std::move(fragments)};
+  }
+
+  void FragmentCache::InvalidateBus(std::string_view name) {
+    std::lock_guard lock(mutex_);
+    buses_.erase(std::string(name));
+  }
+
+  void FragmentCache::InvalidateStop(std::string_view name) {
+    std::lock_guard lock(mutex_);
+    stops_.erase(std::string(name));
+  }
+
+  void FragmentCache::Reset(const ProjectorState& state) {
+    if (state == state_) return;
+    state_ = state;
+    buses_.clear();
+    stops_.clear();
+  }
+
+  MapRenderer::MapRenderer(const RenderSettings& render_settings, std::shared_ptr <FragmentCache> fragments)
+    : render_settings_(render_settings)
+    , cache_(fragments && fragments -> IsFor(render_settings) ? std::move(fragments) : std::make_shared <FragmentCache>(render_settings)) {}
+
+  const std::shared_ptr <FragmentCache>& MapRenderer::GetFragmentCache() const {
+    return cache_;
+  }
+
+  const RenderSettings MapRenderer::GetSettings() const {
+    return render_settings_;
   }
 
-  svg::Document MapRenderer::CreateBusesMap(const transport::TransportCatalogue& catalogue) const {
-    svg::Document result;
+  RenderScene MapRenderer::CreateScene(const transport::TransportCatalogue& catalogue) const {
+    RenderScene scene;
     std::map <std::string_view, const transport::Bus*> buses = catalogue.GetAllBuses();
-    std::vector <geo::Coordinates> coordinates;
-    std::map <std::string_view, transport::Stop*> all_stops;
+    std::map <std::string_view, const transport::Stop*> all_stops;
     for (const auto& [name, bus]: buses) {
-      if (bus -> stops.empty()) continue;
       for (const auto& stop: bus -> stops) {
         all_stops[stop -> stop_name] = stop;
       }
     }
-    for (const auto[name, stop]: all_stops) {
+    std::vector <geo::Coordinates> coordinates;
+    coordinates.reserve(all_stops.size());
+    for (const auto& [name, stop]: all_stops) {
       coordinates.push_back(stop -> coordinates);
     }
-    const renderer::RenderSettings render_settings = GetSettings();
-    renderer::SphereProjector projector{coordinates.begin(), coordinates.end(), render_settings.width, render_settings.height, render_settings.padding};
-    std::vector <svg::Polyline> lines = CreateBusLine(buses, projector);
-    for (auto& line: lines) {
-      result.Add(std::move(line));
+    const renderer::SphereProjector projector{coordinates.begin(), coordinates.end(), render_settings_.width, render_settings_.height, render_settings_.padding};
+    scene.projector = projector.GetState();
+
+    std::unordered_map <const transport::Stop*, svg::Point> points;
+    scene.stops.reserve(all_stops.size());
+    for (const auto& [name, stop]: all_stops) {
+      scene.stops.push_back({stop, projector(stop -> coordinates)});
+      points[stop] = scene.stops.back().point;
     }
-    std::vector <svg::Text> buses_names = CreateBusName(buses, projector);
-    for (auto& bus_name : buses_names) {
-      result.Add(std::move(bus_name));
+
+    const size_t palette_size = render_settings_.color_palette.size();
+    size_t number = 0;
+    for (const auto& [name, bus]: buses) {
+      if (bus -> stops.empty()) continue;
+      ProjectedBus projected {bus, palette_size ? number % palette_size : 0, {}};
+      projected.points.reserve(bus -> stops.size());
+      for (const auto& stop: bus -> stops) {
+        projected.points.push_back(points.at(stop));
+      }
+      projected.fingerprint = Fingerprint(projected);
+      scene.buses.push_back(std::move(projected));
+      number++;
     }
-    std::vector <svg::Circle> circles = CreateStopCircles(buses, projector);
-    for (auto& circle : circles) {
-      result.Add(std::move(circle));
+    return scene;
+  }
+
+  svg::Polyline MapRenderer::CreateBusLine(const ProjectedBus& projected) const {
+    svg::Polyline line;
+    for (const auto& point : projected.points) {
+      line.AddPoint(point);
     }
-    std::vector <svg::Text> stops_names = CreateStopName(buses, projector);
-    for (auto& stop_name : stops_names) {
-      result.Add(std::move(stop_name));
+    if (projected.bus -> is_roundtrip == false) {
+      for (auto it = std::next(projected.points.rbegin()); it != projected.points.rend(); ++it) {
+        line.AddPoint(*it);
+      }
+    }
+
+    line.SetStrokeColor(render_settings_.color_palette[projected.color_index]);
+    line.SetFillColor("none");
+    line.SetStrokeWidth(render_settings_.line_width);
+    line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    return line;
+  }
+
+  std::vector <svg::Text> MapRenderer::CreateBusName(const ProjectedBus& projected) const {
+    std::vector <svg::Text> result;
+    const transport::Bus* bus = projected.bus;
+    svg::Text name;
+    name.SetPosition(projected.points.front());
+    name.SetOffset(render_settings_.bus_label_offset);
+    name.SetFontSize(render_settings_.bus_label_font_size);
+    name.SetFontFamily("Verdana");
+    name.SetFontWeight("bold");
+    name.SetData(std::string(bus -> bus_name));
+    name.SetFillColor(render_settings_.color_palette[projected.color_index]);
+
+    svg::Text underlayer;
+    underlayer.SetPosition(projected.points.front());
+    underlayer.SetOffset(render_settings_.bus_label_offset);
+    underlayer.SetFontSize(render_settings_.bus_label_font_size);
+    underlayer.SetFontFamily("Verdana");
+    underlayer.SetFontWeight("bold");
+    underlayer.SetData(std::string(bus -> bus_name));
+    underlayer.SetFillColor(render_settings_.underlayer_color);
+    underlayer.SetStrokeColor(render_settings_.underlayer_color);
+    underlayer.SetStrokeWidth(render_settings_.underlayer_width);
+    underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+    result.push_back(underlayer);
+    result.push_back(name);
+
+    if (bus -> is_roundtrip == false) {
+      if (bus -> stops[0] != bus -> stops[bus -> stops.size() - 1]) {
+        svg::Text second_name {name};
+        second_name.SetPosition(projected.points.back());
+
+        svg::Text second_underlayer {underlayer};
+        second_underlayer.SetPosition(projected.points.back());
+        result.push_back(second_underlayer);
+        result.push_back(second_name);
+      }
     }
     return result;
   }
 
-  std::string MapRenderer::RenderBusesMap(const transport::TransportCatalogue& catalogue) const {
-    svg::Document doc = CreateBusesMap(catalogue);
+  svg::Circle MapRenderer::CreateStopCircle(const ProjectedStop& projected) const {
+    svg::Circle circle;
+    circle.SetCenter(projected.point);
+    circle.SetRadius(render_settings_.stop_radius);
+    circle.SetFillColor("white");
+    return circle;
+  }
+
+  std::vector <svg::Text> MapRenderer::CreateStopName(const ProjectedStop& projected) const {
+    std::vector <svg::Text> result;
+    const transport::Stop* stop = projected.stop;
+    svg::Text name;
+    name.SetPosition(projected.point);
+    name.SetOffset(render_settings_.stop_label_offset);
+    name.SetFontSize(render_settings_.stop_label_font_size);
+    name.SetFontFamily("Verdana");
+    name.SetData(std::string(stop -> stop_name));
+    name.SetFillColor("black");
+
+    svg::Text underlayer;
+    underlayer.SetPosition(projected.point);
+    underlayer.SetOffset(render_settings_.stop_label_offset);
+    underlayer.SetFontSize(render_settings_.stop_label_font_size);
+    underlayer.SetFontFamily("Verdana");
+    underlayer.SetData(std::string(stop -> stop_name));
+    underlayer.SetFillColor(render_settings_.underlayer_color);
+    underlayer.SetStrokeColor(render_settings_.underlayer_color);
+    underlayer.SetStrokeWidth(render_settings_.underlayer_width);
+    underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+    result.push_back(underlayer);
+    result.push_back(name);
+    return result;
+  }
+
+  std::string MapRenderer::RenderFromScene(const renderer::RenderScene& scene) const {
+    TRACE_SCOPE("render_map", "render");
+    std::vector <std::shared_ptr <const BusFragments>> bus_fragments(scene.buses.size());
+    std::vector <std::shared_ptr <const StopFragments>> stop_fragments(scene.stops.size());
+    std::vector <size_t> missing_buses;
+    std::vector <size_t> missing_stops;
+    for (size_t i = 0; i < scene.buses.size(); ++i) {
+      bus_fragments[i] = cache_ -> FindBus(scene.projector, scene.buses[i]);
+      if (!bus_fragments[i]) missing_buses.push_back(i);
+    }
+    for (size_t i = 0; i < scene.stops.size(); ++i) {
+      stop_fragments[i] = cache_ -> FindStop(scene.projector, scene.stops[i]);
+      if (!stop_fragments[i]) missing_stops.push_back(i);
+    }
+
+    // Only fragments that are not cached are serialized; they only read the
+    // shared scene, so they are produced in parallel.
+    ParallelFor(missing_buses.size() + missing_stops.size(), [&](size_t task) {
+      std::ostringstream first;
+      std::ostringstream second;
+      if (task < missing_buses.size()) {
+        const size_t index = missing_buses[task];
+        RenderFragment(first, CreateBusLine(scene.buses[index]));
+        for (const auto& text : CreateBusName(scene.buses[index])) {
+          RenderFragment(second, text);
+        }
+        bus_fragments[index] = std::make_shared<const BusFragments>(BusFragments{first.str(), second.str()});
+      }
+      else {
+        const size_t index = missing_stops[task - missing_buses.size()];
+        RenderFragment(first, CreateStopCircle(scene.stops[index]));
+        for (const auto& text : CreateStopName(scene.stops[index])) {
+          RenderFragment(second, text);
+        }
+        stop_fragments[index] = std::make_shared<const StopFragments>(StopFragments{first.str(), second.str()});
+      }
+    });
+    for (size_t index : missing_buses) {
+      cache_ -> Store(scene.projector, scene.buses[index], bus_fragments[index]);
+    }
+    for (size_t index : missing_stops) {
+      cache_ -> Store(scene.projector, scene.stops[index], stop_fragments[index]);
+    }
+
     std::ostringstream os;
-    doc.Render(os);
-    std::string map_str = os.str();
+    svg::Document::RenderHeader(os);
+    for (const auto& fragments : bus_fragments) os << fragments -> line;
+    for (const auto& fragments : bus_fragments) os << fragments -> labels;
+    for (const auto& fragments : stop_fragments) os << fragments -> circle;
+    for (const auto& fragments : stop_fragments) os << fragments -> label;
+    svg::Document::RenderFooter(os);
+    return os.str();
+  }
 
-    return map_str;
+  std::string MapRenderer::RenderBusesMap(const transport::TransportCatalogue& catalogue) const {
+    return RenderFromScene(CreateScene(catalogue));
+  }
 
+  std::string MapRenderer::RenderBusesMap(const transport::TransportCatalogue& catalogue, const std::vector <std::string>& bus_names) const {
+    // The projection and palette indices always come from the whole network,
+    // so a partial map lines up with the full one and shares its fragments.
+    renderer::RenderScene scene = CreateScene(catalogue);
+    const std::set <std::string_view> selected(bus_names.begin(), bus_names.end());
+    std::set <const transport::Stop*> served;
+    std::vector <ProjectedBus> buses;
+    for (auto& bus : scene.buses) {
+      if (!selected.count(bus.bus -> bus_name)) continue;
+      served.insert(bus.bus -> stops.begin(), bus.bus -> stops.end());
+      buses.push_back(std::move(bus));
+    }
+    scene.buses = std::move(buses);
+    scene.stops.erase(std::remove_if(scene.stops.begin(), scene.stops.end(), [&served](const ProjectedStop& stop) {
+      return !served.count(stop.stop);
+    }), scene.stops.end());
+    return RenderFromScene(scene);
   }
 }
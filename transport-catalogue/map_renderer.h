@@ -11,7 +11,12 @@
 #include <optional>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace renderer {
 
@@ -20,6 +25,19 @@ namespace renderer {
     return std::abs(value) < EPSILON;
   }
 
+  struct ProjectorState {
+    double padding = 0;
+    double min_lon = 0;
+    double max_lat = 0;
+    double zoom_coeff = 0;
+    bool operator == (const ProjectorState & other) const {
+      return padding == other.padding && min_lon == other.min_lon && max_lat == other.max_lat && zoom_coeff == other.zoom_coeff;
+    }
+    bool operator != (const ProjectorState & other) const {
+      return !( * this == other);
+    }
+  };
+
   class SphereProjector {
     public:
       template < typename PointInputIt >
@@ -63,6 +81,10 @@ namespace renderer {
         return {(coords.lng - min_lon_) * zoom_coeff_ + padding_, (max_lat_ - coords.lat) * zoom_coeff_ + padding_};
       }
 
+      ProjectorState GetState() const {
+        return {padding_, min_lon_, max_lat_, zoom_coeff_};
+      }
+
     private: 
       double padding_;
       double min_lon_ = 0;
@@ -85,24 +107,100 @@ namespace renderer {
     std::vector < svg::Color > color_palette {};
   };
 
+  struct ProjectedStop {
+    const transport::Stop* stop;
+    svg::Point point;
+  };
+
+  struct ProjectedBus {
+    const transport::Bus* bus;
+    size_t color_index;
+    std::vector <svg::Point> points;
+    // Hash of everything besides the name and the settings that the bus's
+    // fragments are drawn from, so a cached entry is checked in one compare.
+    size_t fingerprint = 0;
+  };
+
+  // Everything the layers need, computed once per render: stops that are
+  // served by at least one bus sorted by name, and non-empty buses sorted by
+  // name with their projected route and palette index.
+  struct RenderScene {
+    ProjectorState projector;
+    std::vector <ProjectedStop> stops;
+    std::vector <ProjectedBus> buses;
+  };
+
+  struct BusFragments {
+    std::string line;
+    std::string labels;
+  };
+
+  struct StopFragments {
+    std::string circle;
+    std::string label;
+  };
+
+  // Serialized SVG per bus and per stop from previous renders under one set
+  // of render settings. A bus entry is reused while the bus's fingerprint is
+  // unchanged and a stop entry while its projected point is; a change of
+  // projector state drops the whole cache. Renderers of successive snapshots
+  // with the same settings share one cache, so after a feed update that
+  // leaves the map's bounds alone only the changed buses and stops are
+  // serialized again.
+  class FragmentCache {
+    public:
+      struct BusEntry {
+        size_t fingerprint;
+        std::shared_ptr <const BusFragments> fragments;
+      };
+
+      struct StopEntry {
+        svg::Point point;
+        std::shared_ptr <const StopFragments> fragments;
+      };
+
+      explicit FragmentCache(const RenderSettings & settings);
+
+      bool IsFor(const RenderSettings & settings) const;
+      std::shared_ptr <const BusFragments> FindBus(const ProjectorState & state, const ProjectedBus & bus) const;
+      std::shared_ptr <const StopFragments> FindStop(const ProjectorState & state, const ProjectedStop & stop) const;
+      void Store(const ProjectorState & state, const ProjectedBus & bus, std::shared_ptr <const BusFragments> fragments);
+      void Store(const ProjectorState & state, const ProjectedStop & stop, std::shared_ptr <const StopFragments> fragments);
+      // Drop the entry of a bus or stop, e.g. one no longer in the feed.
+      void InvalidateBus(std::string_view name);
+      void InvalidateStop(std::string_view name);
+
+    private:
+      void Reset(const ProjectorState & state);
+
+      const RenderSettings settings_;
+      mutable std::mutex mutex_;
+      ProjectorState state_;
+      std::unordered_map <std::string, BusEntry> buses_;
+      std::unordered_map <std::string, StopEntry> stops_;
+  };
+
   class MapRenderer {
-    public: MapRenderer() {}
+    public: MapRenderer(): MapRenderer(RenderSettings {}) {}
 
-      MapRenderer(const RenderSettings & render_settings): render_settings_(render_settings) {}
+      MapRenderer(const RenderSettings & render_settings): MapRenderer(render_settings, nullptr) {}
+      // Draws into fragments if it was filled under the same settings, and
+      // into a cache of its own otherwise.
+      MapRenderer(const RenderSettings & render_settings, std::shared_ptr <FragmentCache> fragments);
       std::string RenderBusesMap(const transport::TransportCatalogue & catalogue) const;
+      std::string RenderBusesMap(const transport::TransportCatalogue & catalogue, const std::vector <std::string> & bus_names) const;
+      RenderScene CreateScene(const transport::TransportCatalogue & catalogue) const;
+      const std::shared_ptr <FragmentCache> & GetFragmentCache() const;
       private: 
       const RenderSettings render_settings_;
+      const std::shared_ptr <FragmentCache> cache_;
 
       const RenderSettings GetSettings() const;
-      std::vector < svg::Polyline > CreateBusLine(std::map < std::string_view,
-      const transport::Bus * > buses, renderer::SphereProjector & projector) const;
-      std::vector < svg::Text > CreateBusName(std::map < std::string_view,
-      const transport::Bus * > & buses, renderer::SphereProjector & projector) const;
-      std::vector < svg::Circle > CreateStopCircles(std::map < std::string_view,
-      const transport::Bus * > & buses, renderer::SphereProjector & projector) const;
-      std::vector < svg::Text > CreateStopName(std::map < std::string_view,
-      const transport::Bus * > & buses, renderer::SphereProjector & projector) const;
-      svg::Document CreateBusesMap(const transport::TransportCatalogue & catalogue) const;
+      std::string RenderFromScene(const RenderScene & scene) const;
+      svg::Polyline CreateBusLine(const ProjectedBus & projected) const;
+      std::vector < svg::Text > CreateBusName(const ProjectedBus & projected) const;
+      svg::Circle CreateStopCircle(const ProjectedStop & projected) const;
+      std::vector < svg::Text > CreateStopName(const ProjectedStop & projected) const;
   };
 
 } 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Estimates of heap bytes owned by standard containers, modelled on the
+// libstdc++ layouts: node-based containers pay a node header per element and
+// hash tables a bucket array on top of that. Types outside std get an
+// overload of DynamicMemory in their own namespace, found by ADL.
+namespace memory {
+
+  struct Usage {
+    std::vector <std::pair <std::string, size_t>> parts;
+
+    void Add(std::string name, size_t bytes) {
+      parts.emplace_back(std::move(name), bytes);
+    }
+
+    size_t Total() const {
+      size_t total = 0;
+      for (const auto& [name, bytes] : parts) total += bytes;
+      return total;
+    }
+  };
+
+  inline constexpr size_t TREE_NODE_HEADER = 4 * sizeof(void*);
+  inline constexpr size_t HASH_NODE_HEADER = sizeof(void*) + sizeof(size_t);
+  inline constexpr size_t DEQUE_BLOCK_BYTES = 512;
+
+  template <typename T>
+  size_t DynamicMemory(const T&) {
+    return 0;
+  }
+
+  template <typename A>
+  size_t DynamicMemory(const std::basic_string <char, std::char_traits <char>, A>& value) {
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+  }
+
+  template <typename T1, typename T2>
+  size_t DynamicMemory(const std::pair <T1, T2>& value);
+  template <typename T>
+  size_t DynamicMemory(const std::optional <T>& value);
+  template <typename T, typename A>
+  size_t DynamicMemory(const std::vector <T, A>& value);
+  template <typename T, typename A>
+  size_t DynamicMemory(const std::deque <T, A>& value);
+  template <typename T, typename C, typename A>
+  size_t DynamicMemory(const std::set <T, C, A>& value);
+  template <typename K, typename V, typename C, typename A>
+  size_t DynamicMemory(const std::map <K, V, C, A>& value);
+  template <typename K, typename H, typename E, typename A>
+  size_t DynamicMemory(const std::unordered_set <K, H, E, A>& value);
+  template <typename K, typename V, typename H, typename E, typename A>
+  size_t DynamicMemory(const std::unordered_map <K, V, H, E, A>& value);
+
+  template <typename Container>
+  size_t ElementsMemory(const Container& container) {
+    using Element = typename Container::value_type;
+    if constexpr (std::is_trivially_destructible_v <Element>) {
+      return 0;
+    }
+    else {
+      size_t total = 0;
+      for (const auto& element : container) total += DynamicMemory(element);
+      return total;
+    }
+  }
+
+  template <typename T1, typename T2>
+  size_t DynamicMemory(const std::pair <T1, T2>& value) {
+    return DynamicMemory(value.first) + DynamicMemory(value.second);
+  }
+
+  template <typename T>
+  size_t DynamicMemory(const std::optional <T>& value) {
+    return value ? DynamicMemory(*value) : 0;
+  }
+
+  template <typename T, typename A>
+  size_t DynamicMemory(const std::vector <T, A>& value) {
+    return value.capacity() * sizeof(T) + ElementsMemory(value);
+  }
+
+  template <typename T, typename A>
+  size_t DynamicMemory(const std::deque <T, A>& value) {
+    const size_t per_block = sizeof(T) < DEQUE_BLOCK_BYTES ? DEQUE_BLOCK_BYTES / sizeof(T) : 1;
+    const size_t blocks = value.size() / per_block + 1;
+    const size_t map_slots = std::max <size_t> (8, blocks + 2);
+    return blocks * per_block * sizeof(T) + map_slots * sizeof(void*) + ElementsMemory(value);
+  }
+
+  template <typename T, typename C, typename A>
+  size_t DynamicMemory(const std::set <T, C, A>& value) {
+    return value.size() * (TREE_NODE_HEADER + sizeof(T)) + ElementsMemory(value);
+  }
+
+  template <typename K, typename V, typename C, typename A>
+  size_t DynamicMemory(const std::map <K, V, C, A>& value) {
+    return value.size() * (TREE_NODE_HEADER + sizeof(std::pair <const K, V>)) + ElementsMemory(value);
+  }
+
+  template <typename K, typename H, typename E, typename A>
+  size_t DynamicMemory(const std::unordered_set <K, H, E, A>& value) {
+    return value.bucket_count() * sizeof(void*) + value.size() * (HASH_NODE_HEADER + sizeof(K)) + ElementsMemory(value);
+  }
+
+  template <typename K, typename V, typename H, typename E, typename A>
+  size_t DynamicMemory(const std::unordered_map <K, V, H, E, A>& value) {
+    return value.bucket_count() * sizeof(void*) + value.size() * (HASH_NODE_HEADER + sizeof(std::pair <const K, V>)) + ElementsMemory(value);
+  }
+
+  template <typename T>
+  size_t TotalMemory(const T& value) {
+    return sizeof(T) + DynamicMemory(value);
+  }
+
+  inline void PrintUsage(std::ostream& out, const Usage& usage) {
+    out << "{\"total_bytes\": " << usage.Total();
+    for (const auto& [name, bytes] : usage.parts) {
+      out << ", \"" << name << "\": " << bytes;
+    }
+    out << "}";
+  }
+
+}
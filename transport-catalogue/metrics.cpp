@@ -0,0 +1,151 @@
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace metrics {
+
+  namespace {
+
+    std::array <Histogram, static_cast <size_t> (Phase::COUNT)>& Histograms() {
+      static std::array <Histogram, static_cast <size_t> (Phase::COUNT)> histograms;
+      return histograms;
+    }
+
+    std::array <std::atomic <uint64_t>, static_cast <size_t> (Counter::COUNT)>& Counters() {
+      static std::array <std::atomic <uint64_t>, static_cast <size_t> (Counter::COUNT)> counters {};
+      return counters;
+    }
+
+    size_t BucketIndex(uint64_t nanoseconds) {
+      size_t index = 0;
+      while (nanoseconds > 1 && index + 1 < Histogram::BUCKETS) {
+        nanoseconds >>= 1;
+        ++index;
+      }
+      return index;
+    }
+
+  }
+
+  void Histogram::Record(uint64_t nanoseconds) {
+    buckets_[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {}
+  }
+
+  uint64_t Histogram::GetCount() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Histogram::GetSum() const {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Histogram::GetMax() const {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Histogram::GetBucket(size_t index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  uint64_t Histogram::GetQuantile(double quantile) const {
+    const uint64_t count = GetCount();
+    if (count == 0) return 0;
+    const uint64_t rank = static_cast <uint64_t> (quantile * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      seen += GetBucket(i);
+      if (seen >= rank) return std::min(GetMax(), (uint64_t {2} << i) - 1);
+    }
+    return GetMax();
+  }
+
+  void Record(Phase phase, uint64_t nanoseconds) {
+    Histograms()[static_cast <size_t> (phase)].Record(nanoseconds);
+  }
+
+  void Add(Counter counter, uint64_t value) {
+    Counters()[static_cast <size_t> (counter)].fetch_add(value, std::memory_order_relaxed);
+  }
+
+  const Histogram& GetHistogram(Phase phase) {
+    return Histograms()[static_cast <size_t> (phase)];
+  }
+
+  uint64_t GetCounter(Counter counter) {
+    return Counters()[static_cast <size_t> (counter)].load(std::memory_order_relaxed);
+  }
+
+  const char* GetName(Phase phase) {
+    switch (phase) {
+    case Phase::JSON_LOAD: return "json_load";
+    case Phase::PARSE_CATALOGUE: return "parse_catalogue";
+    case Phase::GRAPH_BUILD: return "graph_build";
+    case Phase::ROUTER_PREPROCESS: return "router_preprocess";
+    case Phase::ROUTER_CUSTOMIZE: return "router_customize";
+    case Phase::STOP_REQUEST: return "stop_request";
+    case Phase::BUS_REQUEST: return "bus_request";
+    case Phase::ROUTE_REQUEST: return "route_request";
+    case Phase::MAP_REQUEST: return "map_request";
+    case Phase::ROUTE_MATRIX_REQUEST: return "route_matrix_request";
+    case Phase::STOP_SEARCH_REQUEST: return "stop_search_request";
+    case Phase::COUNT: break;
+    }
+    return "unknown";
+  }
+
+  const char* GetName(Counter counter) {
+    switch (counter) {
+    case Counter::STOPS: return "stops";
+    case Counter::BUSES: return "buses";
+    case Counter::GRAPH_VERTICES: return "graph_vertices";
+    case Counter::GRAPH_EDGES: return "graph_edges";
+    case Counter::REQUESTS: return "requests";
+    case Counter::NOT_FOUND: return "not_found";
+    case Counter::ROUTE_CACHE_HITS: return "route_cache_hits";
+    case Counter::ROUTE_CACHE_MISSES: return "route_cache_misses";
+    case Counter::ROUTE_CACHE_REJECTED: return "route_cache_rejected";
+    case Counter::ROUTE_CACHE_EVICTIONS: return "route_cache_evictions";
+    case Counter::PARTITION_FALLBACKS: return "partition_fallbacks";
+    case Counter::COUNT: break;
+    }
+    return "unknown";
+  }
+
+  // Written by hand rather than through json::Node, which has no 64-bit
+  // integers and would print large nanosecond totals in exponent form.
+  void Dump(std::ostream& out) {
+    out << "{\n  \"enabled\": " << (TRANSPORT_METRICS ? "true" : "false") << ",\n  \"phases\": {";
+    bool first = true;
+    for (size_t i = 0; i < static_cast <size_t> (Phase::COUNT); ++i) {
+      const Histogram& histogram = Histograms()[i];
+      if (histogram.GetCount() == 0) continue;
+      out << (first ? "\n" : ",\n") << "    \"" << GetName(static_cast <Phase> (i)) << "\": {"
+          << "\"count\": " << histogram.GetCount()
+          << ", \"total_ns\": " << histogram.GetSum()
+          << ", \"max_ns\": " << histogram.GetMax()
+          << ", \"p50_ns\": " << histogram.GetQuantile(0.5)
+          << ", \"p90_ns\": " << histogram.GetQuantile(0.9)
+          << ", \"p99_ns\": " << histogram.GetQuantile(0.99)
+          << ", \"buckets\": [";
+      bool first_bucket = true;
+      for (size_t bucket = 0; bucket < Histogram::BUCKETS; ++bucket) {
+        if (const uint64_t count = histogram.GetBucket(bucket)) {
+          out << (first_bucket ? "" : ", ") << "[" << ((uint64_t {2} << bucket) - 1) << ", " << count << "]";
+          first_bucket = false;
+        }
+      }
+      out << "]}";
+      first = false;
+    }
+    out << "\n  },\n  \"counters\": {";
+    for (size_t i = 0; i < static_cast <size_t> (Counter::COUNT); ++i) {
+      out << (i ? ",\n" : "\n") << "    \"" << GetName(static_cast <Counter> (i)) << "\": " << Counters()[i].load(std::memory_order_relaxed);
+    }
+    out << "\n  }\n}" << std::endl;
+  }
+
+}
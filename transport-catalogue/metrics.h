@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Build with -DTRANSPORT_METRICS=0 to compile every probe out of the request
+// path; the dump then reports an empty document.
+#ifndef TRANSPORT_METRICS
+#define TRANSPORT_METRICS 1
+#endif
+
+namespace metrics {
+
+  enum class Phase {
+    JSON_LOAD,
+    PARSE_CATALOGUE,
+    GRAPH_BUILD,
+    ROUTER_PREPROCESS,
+    ROUTER_CUSTOMIZE,
+    STOP_REQUEST,
+    BUS_REQUEST,
+    ROUTE_REQUEST,
+    MAP_REQUEST,
+    ROUTE_MATRIX_REQUEST,
+    STOP_SEARCH_REQUEST,
+    COUNT,
+  };
+
+  enum class Counter {
+    STOPS,
+    BUSES,
+    GRAPH_VERTICES,
+    GRAPH_EDGES,
+    REQUESTS,
+    NOT_FOUND,
+    ROUTE_CACHE_HITS,
+    ROUTE_CACHE_MISSES,
+    ROUTE_CACHE_REJECTED,
+    ROUTE_CACHE_EVICTIONS,
+    PARTITION_FALLBACKS,
+    COUNT,
+  };
+
+  // Latencies go into power-of-two nanosecond buckets: bucket i holds samples
+  // in [2^i, 2^(i+1)) ns. Every field is a relaxed atomic, so recording from
+  // several threads needs no lock.
+  class Histogram {
+    public:
+      static constexpr size_t BUCKETS = 48;
+
+      void Record(uint64_t nanoseconds);
+      uint64_t GetCount() const;
+      uint64_t GetSum() const;
+      uint64_t GetMax() const;
+      uint64_t GetBucket(size_t index) const;
+      // Upper bound of the bucket holding the given quantile.
+      uint64_t GetQuantile(double quantile) const;
+
+    private:
+      std::array <std::atomic <uint64_t>, BUCKETS> buckets_ {};
+      std::atomic <uint64_t> count_ {0};
+      std::atomic <uint64_t> sum_ {0};
+      std::atomic <uint64_t> max_ {0};
+  };
+
+  void Record(Phase phase, uint64_t nanoseconds);
+  void Add(Counter counter, uint64_t value = 1);
+  const Histogram& GetHistogram(Phase phase);
+  uint64_t GetCounter(Counter counter);
+  const char* GetName(Phase phase);
+  const char* GetName(Counter counter);
+  void Dump(std::ostream& out);
+
+  class ScopeTimer {
+    public:
+      explicit ScopeTimer(Phase phase)
+      : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+      ~ScopeTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        Record(phase_, std::chrono::duration_cast <std::chrono::nanoseconds> (elapsed).count());
+      }
+
+      ScopeTimer(const ScopeTimer&) = delete;
+      ScopeTimer& operator = (const ScopeTimer&) = delete;
+
+    private:
+      Phase phase_;
+      std::chrono::steady_clock::time_point start_;
+  };
+
+}
+
+#define METRICS_CONCAT_IMPL(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_IMPL(a, b)
+
+#if TRANSPORT_METRICS
+#define METRICS_SCOPE(phase) ::metrics::ScopeTimer METRICS_CONCAT(metrics_scope_, __LINE__) {phase}
+#define METRICS_ADD(counter, value) ::metrics::Add(counter, value)
+#else
+// The arguments stay unevaluated but used, so a variable or lambda parameter
+// that only feeds a probe does not become unused.
+#define METRICS_SCOPE(phase) static_cast <void> (sizeof(phase))
+#define METRICS_ADD(counter, value) static_cast <void> (sizeof(counter) + sizeof(value))
+#endif
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Binary min-heap of (key, vertex) pairs; equal keys pop the smaller vertex
+// first.
+template <typename Key>
+class BinaryHeap {
+public:
+    using Item = std::pair<Key, VertexId>;
+
+    bool IsEmpty() const;
+    void Clear();
+    void Push(Key key, VertexId vertex);
+    Item Pop();
+
+private:
+    std::vector<Item> items_;
+};
+
+// Monotone min-queue for unsigned integer keys: a pushed key must not be
+// smaller than the last popped one, which holds for Dijkstra and for A* with
+// a consistent bound. Each item sits in the bucket of the highest bit in
+// which its key differs from the last popped key, so it moves to a lower
+// bucket at most once per key bit and pushes and pops cost no comparisons
+// between items.
+template <typename Key>
+class RadixHeap {
+    static_assert(std::is_unsigned_v<Key>, "radix heap keys must be unsigned integers");
+
+public:
+    using Item = std::pair<Key, VertexId>;
+
+    bool IsEmpty() const;
+    void Clear();
+    void Push(Key key, VertexId vertex);
+    Item Pop();
+
+private:
+    static constexpr size_t KEY_BITS = std::numeric_limits<Key>::digits;
+
+    size_t GetBucket(Key key) const;
+
+    Key last_ = 0;
+    size_t size_ = 0;
+    // Bucket 0 holds keys equal to last_, bucket b keys whose highest bit
+    // differing from last_ is bit b - 1.
+    std::array<std::vector<Item>, KEY_BITS + 1> buckets_;
+};
+
+// The queue searches use for a weight type, chosen at compile time.
+template <typename Weight>
+using MinQueue = std::conditional_t<std::is_unsigned_v<Weight>, RadixHeap<Weight>, BinaryHeap<Weight>>;
+
+template <typename Key>
+bool BinaryHeap<Key>::IsEmpty() const {
+    return items_.empty();
+}
+
+template <typename Key>
+void BinaryHeap<Key>::Clear() {
+    items_.clear();
+}
+
+template <typename Key>
+void BinaryHeap<Key>::Push(Key key, VertexId vertex) {
+    items_.push_back({key, vertex});
+    std::push_heap(items_.begin(), items_.end(), std::greater<Item>());
+}
+
+template <typename Key>
+typename BinaryHeap<Key>::Item BinaryHeap<Key>::Pop() {
+    std::pop_heap(items_.begin(), items_.end(), std::greater<Item>());
+    const Item item = items_.back();
+    items_.pop_back();
+    return item;
+}
+
+template <typename Key>
+bool RadixHeap<Key>::IsEmpty() const {
+    return size_ == 0;
+}
+
+template <typename Key>
+void RadixHeap<Key>::Clear() {
+    for (auto& bucket : buckets_) {
+        bucket.clear();
+    }
+    last_ = 0;
+    size_ = 0;
+}
+
+template <typename Key>
+size_t RadixHeap<Key>::GetBucket(Key key) const {
+    Key difference = key ^ last_;
+    if (difference == 0) {
+        return 0;
+    }
+#if defined(__GNUC__)
+    // The bit scan is most of a push; the loop below costs about as much as
+    // the heap sifting this queue replaces.
+    return std::numeric_limits<unsigned long long>::digits
+        - __builtin_clzll(static_cast<unsigned long long>(difference));
+#else
+    size_t bit = 0;
+    for (size_t shift = KEY_BITS / 2; shift > 0; shift /= 2) {
+        if (difference >> shift) {
+            difference >>= shift;
+            bit += shift;
+        }
+    }
+    return bit + 1;
+#endif
+}
+
+template <typename Key>
+void RadixHeap<Key>::Push(Key key, VertexId vertex) {
+    buckets_[GetBucket(key)].push_back({key, vertex});
+    ++size_;
+}
+
+template <typename Key>
+typename RadixHeap<Key>::Item RadixHeap<Key>::Pop() {
+    if (buckets_[0].empty()) {
+        size_t index = 1;
+        while (buckets_[index].empty()) {
+            ++index;
+        }
+        // Every key in the bucket agrees with the new minimum above bit
+        // index - 1, so they all land in lower buckets.
+        auto& bucket = buckets_[index];
+        last_ = std::min_element(bucket.begin(), bucket.end())->first;
+        for (const Item& item : bucket) {
+            buckets_[GetBucket(item.first)].push_back(item);
+        }
+        bucket.clear();
+    }
+    const Item item = buckets_[0].back();
+    buckets_[0].pop_back();
+    --size_;
+    return item;
+}
+
+}  // namespace graph
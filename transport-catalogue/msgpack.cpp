@@ -0,0 +1,259 @@
+#include "msgpack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+
+using namespace std;
+
+namespace msgpack {
+
+  namespace {
+
+    template < typename Integer >
+    void WriteBigEndian(Integer value, std::ostream & output) {
+      char bytes[sizeof(Integer)];
+      for (size_t i = 0; i < sizeof(Integer); ++i) {
+        bytes[i] = static_cast < char > (static_cast < uint64_t > (value) >> (8 * (sizeof(Integer) - 1 - i)));
+      }
+      output.write(bytes, sizeof(Integer));
+    }
+
+    void WriteTag(uint8_t tag, std::ostream & output) {
+      output.put(static_cast < char > (tag));
+    }
+
+    template < typename Integer >
+    Integer ReadBigEndian(std::istream & input) {
+      char bytes[sizeof(Integer)];
+      if (!input.read(bytes, sizeof(Integer))) {
+        throw json::ParsingError("Unexpected end of MessagePack input"s);
+      }
+      uint64_t value = 0;
+      for (size_t i = 0; i < sizeof(Integer); ++i) {
+        value = (value << 8) | static_cast < uint8_t > (bytes[i]);
+      }
+      return static_cast < Integer > (value);
+    }
+
+    json::Node LoadNode(std::istream & input);
+
+    json::Node IntegerNode(int64_t value) {
+      if (value >= numeric_limits < int > ::min() && value <= numeric_limits < int > ::max()) {
+        return json::Node(static_cast < int > (value));
+      }
+      return json::Node(static_cast < double > (value));
+    }
+
+    // Lengths come from the input, so at most this much is allocated ahead
+    // of the data actually read; a length larger than the input fails on the
+    // missing bytes instead of on the allocation.
+    const size_t READ_CHUNK = 64 * 1024;
+    const size_t MAX_RESERVED_ELEMENTS = 4096;
+
+    std::string LoadString(std::istream & input, size_t size) {
+      std::string value;
+      while (value.size() < size) {
+        const size_t offset = value.size();
+        const size_t chunk = std::min(size - offset, READ_CHUNK);
+        value.resize(offset + chunk);
+        if (!input.read(value.data() + offset, chunk)) {
+          throw json::ParsingError("Unexpected end of MessagePack string"s);
+        }
+      }
+      return value;
+    }
+
+    json::Node LoadArray(std::istream & input, size_t size) {
+      json::Array result;
+      result.reserve(std::min(size, MAX_RESERVED_ELEMENTS));
+      for (size_t i = 0; i < size; ++i) {
+        result.push_back(LoadNode(input));
+      }
+      return json::Node(std::move(result));
+    }
+
+    json::Node LoadMap(std::istream & input, size_t size) {
+      json::Dict result;
+      for (size_t i = 0; i < size; ++i) {
+        json::Node key = LoadNode(input);
+        if (!key.IsString()) {
+          throw json::ParsingError("MessagePack map keys must be strings"s);
+        }
+        if (result.count(key.AsString())) {
+          throw json::ParsingError("Duplicate key '"s + key.AsString() + "' have been found"s);
+        }
+        json::Node value = LoadNode(input);
+        result.emplace(key.AsString(), std::move(value));
+      }
+      return json::Node(std::move(result));
+    }
+
+    json::Node LoadNode(std::istream & input) {
+      const int tag_char = input.get();
+      if (tag_char == std::char_traits < char > ::eof()) {
+        throw json::ParsingError("Unexpected end of MessagePack input"s);
+      }
+      const uint8_t tag = static_cast < uint8_t > (tag_char);
+      if (tag <= 0x7f) return json::Node(static_cast < int > (tag));
+      if (tag >= 0xe0) return json::Node(static_cast < int > (static_cast < int8_t > (tag)));
+      if ((tag & 0xf0) == 0x80) return LoadMap(input, tag & 0x0f);
+      if ((tag & 0xf0) == 0x90) return LoadArray(input, tag & 0x0f);
+      if ((tag & 0xe0) == 0xa0) return json::Node(LoadString(input, tag & 0x1f));
+      switch (tag) {
+      case 0xc0:
+        return json::Node(nullptr);
+      case 0xc2:
+        return json::Node(false);
+      case 0xc3:
+        return json::Node(true);
+      case 0xca: {
+        const uint32_t bits = ReadBigEndian < uint32_t > (input);
+        float value;
+        std::memcpy( & value, & bits, sizeof(value));
+        return json::Node(static_cast < double > (value));
+      }
+      case 0xcb: {
+        const uint64_t bits = ReadBigEndian < uint64_t > (input);
+        double value;
+        std::memcpy( & value, & bits, sizeof(value));
+        return json::Node(value);
+      }
+      case 0xcc:
+        return IntegerNode(ReadBigEndian < uint8_t > (input));
+      case 0xcd:
+        return IntegerNode(ReadBigEndian < uint16_t > (input));
+      case 0xce:
+        return IntegerNode(ReadBigEndian < uint32_t > (input));
+      case 0xcf:
+        return json::Node(static_cast < double > (ReadBigEndian < uint64_t > (input)));
+      case 0xd0:
+        return IntegerNode(ReadBigEndian < int8_t > (input));
+      case 0xd1:
+        return IntegerNode(ReadBigEndian < int16_t > (input));
+      case 0xd2:
+        return IntegerNode(ReadBigEndian < int32_t > (input));
+      case 0xd3:
+        return IntegerNode(ReadBigEndian < int64_t > (input));
+      case 0xd9:
+        return json::Node(LoadString(input, ReadBigEndian < uint8_t > (input)));
+      case 0xda:
+        return json::Node(LoadString(input, ReadBigEndian < uint16_t > (input)));
+      case 0xdb:
+        return json::Node(LoadString(input, ReadBigEndian < uint32_t > (input)));
+      case 0xdc:
+        return LoadArray(input, ReadBigEndian < uint16_t > (input));
+      case 0xdd:
+        return LoadArray(input, ReadBigEndian < uint32_t > (input));
+      case 0xde:
+        return LoadMap(input, ReadBigEndian < uint16_t > (input));
+      case 0xdf:
+        return LoadMap(input, ReadBigEndian < uint32_t > (input));
+      default:
+        throw json::ParsingError("Unsupported MessagePack type "s + std::to_string(tag));
+      }
+    }
+
+  }
+
+  json::Document Load(std::istream & input) {
+    return json::Document {
+      LoadNode(input)
+    };
+  }
+
+  void WriteArrayHeader(size_t size, std::ostream & output) {
+    if (size <= 0x0f) {
+      WriteTag(static_cast < uint8_t > (0x90 | size), output);
+    } else if (size <= numeric_limits < uint16_t > ::max()) {
+      WriteTag(0xdc, output);
+      WriteBigEndian(static_cast < uint16_t > (size), output);
+    } else {
+      WriteTag(0xdd, output);
+      WriteBigEndian(static_cast < uint32_t > (size), output);
+    }
+  }
+
+  void WriteMapHeader(size_t size, std::ostream & output) {
+    if (size <= 0x0f) {
+      WriteTag(static_cast < uint8_t > (0x80 | size), output);
+    } else if (size <= numeric_limits < uint16_t > ::max()) {
+      WriteTag(0xde, output);
+      WriteBigEndian(static_cast < uint16_t > (size), output);
+    } else {
+      WriteTag(0xdf, output);
+      WriteBigEndian(static_cast < uint32_t > (size), output);
+    }
+  }
+
+  void WriteString(std::string_view value, std::ostream & output) {
+    const size_t size = value.size();
+    if (size <= 0x1f) {
+      WriteTag(static_cast < uint8_t > (0xa0 | size), output);
+    } else if (size <= numeric_limits < uint8_t > ::max()) {
+      WriteTag(0xd9, output);
+      WriteBigEndian(static_cast < uint8_t > (size), output);
+    } else if (size <= numeric_limits < uint16_t > ::max()) {
+      WriteTag(0xda, output);
+      WriteBigEndian(static_cast < uint16_t > (size), output);
+    } else {
+      WriteTag(0xdb, output);
+      WriteBigEndian(static_cast < uint32_t > (size), output);
+    }
+    output.write(value.data(), size);
+  }
+
+  void WriteInt(int64_t value, std::ostream & output) {
+    if (value >= 0 && value <= 0x7f) {
+      WriteTag(static_cast < uint8_t > (value), output);
+    } else if (value < 0 && value >= -32) {
+      WriteTag(static_cast < uint8_t > (static_cast < int8_t > (value)), output);
+    } else if (value >= numeric_limits < int8_t > ::min() && value <= numeric_limits < int8_t > ::max()) {
+      WriteTag(0xd0, output);
+      WriteBigEndian(static_cast < int8_t > (value), output);
+    } else if (value >= numeric_limits < int16_t > ::min() && value <= numeric_limits < int16_t > ::max()) {
+      WriteTag(0xd1, output);
+      WriteBigEndian(static_cast < int16_t > (value), output);
+    } else if (value >= numeric_limits < int32_t > ::min() && value <= numeric_limits < int32_t > ::max()) {
+      WriteTag(0xd2, output);
+      WriteBigEndian(static_cast < int32_t > (value), output);
+    } else {
+      WriteTag(0xd3, output);
+      WriteBigEndian(value, output);
+    }
+  }
+
+  void WriteDouble(double value, std::ostream & output) {
+    uint64_t bits;
+    std::memcpy( & bits, & value, sizeof(bits));
+    WriteTag(0xcb, output);
+    WriteBigEndian(bits, output);
+  }
+
+  void Write(const json::Node & node, std::ostream & output) {
+    if (node.IsNull()) {
+      WriteTag(0xc0, output);
+    } else if (node.IsBool()) {
+      WriteTag(node.AsBool() ? 0xc3 : 0xc2, output);
+    } else if (node.IsInt()) {
+      WriteInt(node.AsInt(), output);
+    } else if (node.IsPureDouble()) {
+      WriteDouble(node.AsDouble(), output);
+    } else if (node.IsString()) {
+      WriteString(node.AsString(), output);
+    } else if (node.IsArray()) {
+      WriteArrayHeader(node.AsArray().size(), output);
+      for (const json::Node & element: node.AsArray()) {
+        Write(element, output);
+      }
+    } else {
+      WriteMapHeader(node.AsMap().size(), output);
+      for (const auto & [key, value]: node.AsMap()) {
+        WriteString(key, output);
+        Write(value, output);
+      }
+    }
+  }
+
+}
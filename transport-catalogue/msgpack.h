@@ -0,0 +1,25 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+// MessagePack encoding of json::Node, for clients that would rather skip
+// text. Maps must have string keys; integers that do not fit an int are
+// loaded as doubles, as the text parser does. Binary and extension types
+// are rejected with json::ParsingError.
+namespace msgpack {
+
+  json::Document Load(std::istream & input);
+  void Write(const json::Node & node, std::ostream & output);
+
+  // Pieces of Write for streaming a value that is not held in a Node.
+  void WriteArrayHeader(size_t size, std::ostream & output);
+  void WriteMapHeader(size_t size, std::ostream & output);
+  void WriteString(std::string_view value, std::ostream & output);
+  void WriteInt(int64_t value, std::ostream & output);
+  void WriteDouble(double value, std::ostream & output);
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace pool {
+
+// Keeps up to SLOTS idle objects for reuse. Take() empties a full slot, or
+// makes a new object if it finds none; a lease puts its object back into an
+// empty slot, or frees it if all are full. Both scan the slots with atomic
+// exchanges, so neither locks nor waits, and an object set up by one thread
+// serves any other thread afterwards.
+template <typename T, size_t SLOTS = 64>
+class ObjectPool {
+public:
+    // Gives its object back to the pool when destroyed.
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        T& operator*() const;
+        T* operator->() const;
+
+    private:
+        friend class ObjectPool;
+        Lease(const ObjectPool* pool, std::unique_ptr<T> object);
+
+        const ObjectPool* pool_;
+        std::unique_ptr<T> object_;
+    };
+
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    // No lease may outlive the pool.
+    ~ObjectPool();
+
+    Lease Take() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<T*> object{nullptr};
+    };
+
+    void Return(std::unique_ptr<T> object) const;
+    static size_t GetHint();
+
+    mutable std::array<Slot, SLOTS> slots_;
+};
+
+template <typename T, size_t SLOTS>
+ObjectPool<T, SLOTS>::Lease::Lease(const ObjectPool* pool, std::unique_ptr<T> object)
+    : pool_(pool)
+    , object_(std::move(object))
+{
+}
+
+template <typename T, size_t SLOTS>
+ObjectPool<T, SLOTS>::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr))
+    , object_(std::move(other.object_))
+{
+}
+
+template <typename T, size_t SLOTS>
+ObjectPool<T, SLOTS>::Lease::~Lease() {
+    if (pool_ && object_) {
+        pool_->Return(std::move(object_));
+    }
+}
+
+template <typename T, size_t SLOTS>
+T& ObjectPool<T, SLOTS>::Lease::operator*() const {
+    return *object_;
+}
+
+template <typename T, size_t SLOTS>
+T* ObjectPool<T, SLOTS>::Lease::operator->() const {
+    return object_.get();
+}
+
+template <typename T, size_t SLOTS>
+ObjectPool<T, SLOTS>::~ObjectPool() {
+    for (Slot& slot : slots_) {
+        delete slot.object.load();
+    }
+}
+
+template <typename T, size_t SLOTS>
+size_t ObjectPool<T, SLOTS>::GetHint() {
+    // Threads start looking at different slots so that they rarely collide.
+    thread_local const size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return hint;
+}
+
+template <typename T, size_t SLOTS>
+typename ObjectPool<T, SLOTS>::Lease ObjectPool<T, SLOTS>::Take() const {
+    const size_t hint = GetHint();
+    for (size_t attempt = 0; attempt < SLOTS; ++attempt) {
+        Slot& slot = slots_[(hint + attempt) % SLOTS];
+        if (slot.object.load(std::memory_order_relaxed)) {
+            if (T* object = slot.object.exchange(nullptr, std::memory_order_acquire)) {
+                return Lease(this, std::unique_ptr<T>(object));
+            }
+        }
+    }
+    return Lease(this, std::make_unique<T>());
+}
+
+template <typename T, size_t SLOTS>
+void ObjectPool<T, SLOTS>::Return(std::unique_ptr<T> object) const {
+    const size_t hint = GetHint();
+    for (size_t attempt = 0; attempt < SLOTS; ++attempt) {
+        Slot& slot = slots_[(hint + attempt) % SLOTS];
+        T* expected = nullptr;
+        if (slot.object.compare_exchange_strong(expected, object.get(), std::memory_order_release, std::memory_order_relaxed)) {
+            object.release();
+            return;
+        }
+    }
+}
+
+}  // namespace pool
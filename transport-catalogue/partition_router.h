@@ -0,0 +1,451 @@
+#pragma once
+
+#include "graph.h"
+#include "memory_usage.h"
+#include "min_queue.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Partition-based router in the style of Customizable Route Planning, with
+// a single overlay level. Preprocessing depends only on the graph's shape:
+// vertices with edges are grouped into cells of about cell_size, and a vertex
+// is a cell entry if a cut edge ends in it, an exit if one starts in it. Customize()
+// depends on the weights: for every cell it computes shortest distances from
+// each entry to each exit inside the cell, cell by cell in parallel, so a
+// graph with new edge weights costs one customization over an existing
+// router's partition, not a new partition.
+//
+// A query searches the source and target cells edge by edge and crosses every
+// other cell through its entry-exit clique; the clique hops on the final path
+// are then expanded into edges by a search inside their cell.
+//
+// A cell's clique has entries times exits weights, so the overlay only pays
+// off while few vertices lie on cell boundaries. Graphs whose edges skip far
+// ahead, like bus rides spanning many stops, can put nearly every vertex on
+// one; TryBuild measures that before customizing.
+template <typename Weight>
+class PartitionRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    // Query buffers, one per concurrent query, stamped per run like Dijkstra's.
+    class Search {
+    public:
+        explicit Search(const PartitionRouter& router);
+
+    private:
+        friend class PartitionRouter;
+
+        uint32_t generation_ = 0;
+        std::vector<uint32_t> reached_;
+        std::vector<uint32_t> settled_;
+        std::vector<Weight> distances_;
+        std::vector<VertexId> prev_vertices_;
+        // NO_EDGE when the vertex was reached through a clique.
+        std::vector<EdgeId> prev_edges_;
+        MinQueue<Weight> queue_;
+        std::vector<Weight> cell_distances_;
+        std::vector<EdgeId> cell_prev_edges_;
+    };
+
+    PartitionRouter(const Graph& graph, size_t cell_size, size_t threads = 0);
+    // Reuses other's partition for graph, which must have the same vertices
+    // and edges as other's graph in the same order, and customizes it for
+    // graph's weights.
+    PartitionRouter(const PartitionRouter& other, const Graph& graph);
+    // nullptr, without customizing, if more than max_boundary_share of the
+    // vertices with edges end up as cell entries or exits.
+    static std::unique_ptr<PartitionRouter> TryBuild(const Graph& graph, size_t cell_size, double max_boundary_share,
+                                                     size_t threads = 0);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, Search& search) const;
+    size_t GetCellCount() const;
+    // Share of the vertices with edges that are a cell entry, exit or both.
+    double GetBoundaryShare() const;
+    memory::Usage GetMemoryUsage() const;
+
+private:
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    PartitionRouter(const Graph& graph, size_t threads, std::nullptr_t);
+
+    void Partition(size_t cell_size);
+    // Computes the cliques from the graph's weights.
+    void Customize();
+    // Shortest paths from source to the vertices of its own cell, using only
+    // edges inside the cell, indexed by vertex position in the cell.
+    void SearchCell(VertexId source, std::vector<Weight>& distances, std::vector<EdgeId>& prev_edges) const;
+    void AppendCellPath(VertexId from, VertexId to, Search& search, std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    size_t threads_;
+    double boundary_share_ = 0.0;
+    // NO_INDEX for vertices without edges; no route passes through them.
+    std::vector<uint32_t> cells_;
+    // Position of each vertex in its cell's vertex list, and among the cell's
+    // entries and exits (NO_INDEX if it is not one).
+    std::vector<uint32_t> cell_positions_;
+    std::vector<uint32_t> entry_positions_;
+    std::vector<uint32_t> exit_positions_;
+    // Per cell, ranges into the flat vertex, entry, exit and clique arrays.
+    std::vector<size_t> vertex_offsets_;
+    std::vector<VertexId> cell_vertices_;
+    std::vector<size_t> entry_offsets_;
+    std::vector<VertexId> entries_;
+    std::vector<size_t> exit_offsets_;
+    std::vector<VertexId> exits_;
+    std::vector<size_t> clique_offsets_;
+    // Row per entry, column per exit.
+    std::vector<Weight> cliques_;
+};
+
+template <typename Weight>
+PartitionRouter<Weight>::Search::Search(const PartitionRouter& router)
+    : reached_(router.graph_.GetVertexCount(), 0)
+    , settled_(router.graph_.GetVertexCount(), 0)
+    , distances_(router.graph_.GetVertexCount())
+    , prev_vertices_(router.graph_.GetVertexCount())
+    , prev_edges_(router.graph_.GetVertexCount())
+{
+}
+
+template <typename Weight>
+PartitionRouter<Weight>::PartitionRouter(const Graph& graph, size_t threads, std::nullptr_t)
+    : graph_(graph)
+    , threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+template <typename Weight>
+PartitionRouter<Weight>::PartitionRouter(const Graph& graph, size_t cell_size, size_t threads)
+    : PartitionRouter(graph, threads, nullptr)
+{
+    Partition(std::max<size_t>(cell_size, 1));
+    Customize();
+}
+
+template <typename Weight>
+PartitionRouter<Weight>::PartitionRouter(const PartitionRouter& other, const Graph& graph)
+    : graph_(graph)
+    , threads_(other.threads_)
+    , boundary_share_(other.boundary_share_)
+    , cells_(other.cells_)
+    , cell_positions_(other.cell_positions_)
+    , entry_positions_(other.entry_positions_)
+    , exit_positions_(other.exit_positions_)
+    , vertex_offsets_(other.vertex_offsets_)
+    , cell_vertices_(other.cell_vertices_)
+    , entry_offsets_(other.entry_offsets_)
+    , entries_(other.entries_)
+    , exit_offsets_(other.exit_offsets_)
+    , exits_(other.exits_)
+    , clique_offsets_(other.clique_offsets_)
+    , cliques_(other.cliques_.size())
+{
+    Customize();
+}
+
+template <typename Weight>
+std::unique_ptr<PartitionRouter<Weight>> PartitionRouter<Weight>::TryBuild(const Graph& graph, size_t cell_size,
+                                                                          double max_boundary_share, size_t threads) {
+    std::unique_ptr<PartitionRouter> router(new PartitionRouter(graph, threads, nullptr));
+    router->Partition(std::max<size_t>(cell_size, 1));
+    if (router->boundary_share_ > max_boundary_share) {
+        return nullptr;
+    }
+    router->Customize();
+    return router;
+}
+
+template <typename Weight>
+void PartitionRouter<Weight>::Partition(size_t cell_size) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    // Cells are grown breadth-first over edges in either direction; a cell
+    // whose region runs out before cell_size keeps growing from the next
+    // unassigned vertex, so isolated vertices do not end up in cells of one.
+    std::vector<size_t> reverse_offsets(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        ++reverse_offsets[graph_.GetEdge(edge_id).to + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        reverse_offsets[vertex + 1] += reverse_offsets[vertex];
+    }
+    std::vector<VertexId> reverse_neighbours(graph_.GetEdgeCount());
+    std::vector<size_t> fill(reverse_offsets.begin(), reverse_offsets.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        reverse_neighbours[fill[edge.to]++] = edge.from;
+    }
+
+    cells_.assign(vertex_count, NO_INDEX);
+    cell_positions_.assign(vertex_count, NO_INDEX);
+    vertex_offsets_.assign(1, 0);
+    cell_vertices_.clear();
+    cell_vertices_.reserve(vertex_count);
+    uint32_t cell = 0;
+    size_t queue_head = 0;
+    auto visit = [this, &cell](VertexId vertex) {
+        if (cells_[vertex] == NO_INDEX) {
+            cells_[vertex] = cell;
+            cell_positions_[vertex] = static_cast<uint32_t>(cell_vertices_.size() - vertex_offsets_.back());
+            cell_vertices_.push_back(vertex);
+        }
+    };
+    auto has_edges = [this, &reverse_offsets](VertexId vertex) {
+        const auto incident = graph_.GetIncidentEdges(vertex);
+        return incident.begin() != incident.end() || reverse_offsets[vertex] != reverse_offsets[vertex + 1];
+    };
+    for (VertexId seed = 0; seed < vertex_count; ++seed) {
+        // Vertices without edges would only dilute the cells.
+        if (cells_[seed] != NO_INDEX || !has_edges(seed)) {
+            continue;
+        }
+        visit(seed);
+        while (queue_head < cell_vertices_.size() && cell_vertices_.size() - vertex_offsets_.back() < cell_size) {
+            const VertexId vertex = cell_vertices_[queue_head++];
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                if (cell_vertices_.size() - vertex_offsets_.back() < cell_size) {
+                    visit(graph_.GetEdge(edge_id).to);
+                }
+            }
+            for (size_t i = reverse_offsets[vertex]; i < reverse_offsets[vertex + 1]; ++i) {
+                if (cell_vertices_.size() - vertex_offsets_.back() < cell_size) {
+                    visit(reverse_neighbours[i]);
+                }
+            }
+        }
+        if (cell_vertices_.size() - vertex_offsets_.back() >= cell_size) {
+            vertex_offsets_.push_back(cell_vertices_.size());
+            queue_head = cell_vertices_.size();
+            ++cell;
+        }
+    }
+    if (vertex_offsets_.back() != cell_vertices_.size()) {
+        vertex_offsets_.push_back(cell_vertices_.size());
+    }
+
+    const size_t cell_count = vertex_offsets_.size() - 1;
+    std::vector<bool> is_entry(vertex_count, false);
+    std::vector<bool> is_exit(vertex_count, false);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (cells_[edge.from] != cells_[edge.to]) {
+            is_exit[edge.from] = true;
+            is_entry[edge.to] = true;
+        }
+    }
+    entry_positions_.assign(vertex_count, NO_INDEX);
+    exit_positions_.assign(vertex_count, NO_INDEX);
+    entry_offsets_.assign(1, 0);
+    exit_offsets_.assign(1, 0);
+    clique_offsets_.assign(1, 0);
+    entries_.clear();
+    exits_.clear();
+    for (size_t index = 0; index < cell_count; ++index) {
+        for (size_t i = vertex_offsets_[index]; i < vertex_offsets_[index + 1]; ++i) {
+            const VertexId vertex = cell_vertices_[i];
+            if (is_entry[vertex]) {
+                entry_positions_[vertex] = static_cast<uint32_t>(entries_.size() - entry_offsets_.back());
+                entries_.push_back(vertex);
+            }
+            if (is_exit[vertex]) {
+                exit_positions_[vertex] = static_cast<uint32_t>(exits_.size() - exit_offsets_.back());
+                exits_.push_back(vertex);
+            }
+        }
+        const size_t entry_count = entries_.size() - entry_offsets_.back();
+        const size_t exit_count = exits_.size() - exit_offsets_.back();
+        entry_offsets_.push_back(entries_.size());
+        exit_offsets_.push_back(exits_.size());
+        clique_offsets_.push_back(clique_offsets_.back() + entry_count * exit_count);
+    }
+    size_t boundary = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        boundary += is_entry[vertex] || is_exit[vertex] ? 1 : 0;
+    }
+    boundary_share_ = cell_vertices_.empty() ? 0.0 : static_cast<double>(boundary) / cell_vertices_.size();
+}
+
+template <typename Weight>
+void PartitionRouter<Weight>::SearchCell(VertexId source, std::vector<Weight>& distances,
+                                         std::vector<EdgeId>& prev_edges) const {
+    const uint32_t cell = cells_[source];
+    const size_t size = vertex_offsets_[cell + 1] - vertex_offsets_[cell];
+    distances.assign(size, INFINITE_WEIGHT);
+    prev_edges.assign(size, NO_EDGE);
+    MinQueue<Weight> queue;
+    distances[cell_positions_[source]] = Weight{};
+    queue.Push(Weight{}, source);
+    while (!queue.IsEmpty()) {
+        const auto [weight, vertex] = queue.Pop();
+        if (weight > distances[cell_positions_[vertex]]) {
+            continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (cells_[edge.to] != cell) {
+                continue;
+            }
+            const Weight candidate = weight + edge.weight;
+            Weight& distance = distances[cell_positions_[edge.to]];
+            if (candidate < distance) {
+                distance = candidate;
+                prev_edges[cell_positions_[edge.to]] = edge_id;
+                queue.Push(candidate, edge.to);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void PartitionRouter<Weight>::Customize() {
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        if (graph_.GetEdge(edge_id).weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    // Every weight is written below.
+    cliques_.resize(clique_offsets_.back());
+    const size_t cell_count = vertex_offsets_.size() - 1;
+    auto customize_cells = [this, cell_count](size_t worker, size_t workers) {
+        std::vector<Weight> distances;
+        std::vector<EdgeId> prev_edges;
+        for (size_t cell = worker; cell < cell_count; cell += workers) {
+            Weight* row = cliques_.data() + clique_offsets_[cell];
+            for (size_t i = entry_offsets_[cell]; i < entry_offsets_[cell + 1]; ++i) {
+                SearchCell(entries_[i], distances, prev_edges);
+                for (size_t j = exit_offsets_[cell]; j < exit_offsets_[cell + 1]; ++j) {
+                    *row++ = distances[cell_positions_[exits_[j]]];
+                }
+            }
+        }
+    };
+    const size_t workers = std::max<size_t>(std::min(threads_, cell_count), 1);
+    std::vector<std::future<void>> tasks;
+    for (size_t worker = 1; worker < workers; ++worker) {
+        tasks.push_back(std::async(std::launch::async, customize_cells, worker, workers));
+    }
+    customize_cells(0, workers);
+    for (auto& task : tasks) {
+        task.get();
+    }
+}
+
+template <typename Weight>
+std::optional<typename PartitionRouter<Weight>::RouteInfo> PartitionRouter<Weight>::BuildRoute(
+        VertexId from, VertexId to, Search& search) const {
+    if (++search.generation_ == 0) {
+        std::fill(search.reached_.begin(), search.reached_.end(), 0);
+        std::fill(search.settled_.begin(), search.settled_.end(), 0);
+        search.generation_ = 1;
+    }
+    const uint32_t generation = search.generation_;
+    search.queue_.Clear();
+    auto relax = [&search, generation](VertexId vertex, Weight candidate, VertexId prev_vertex, EdgeId prev_edge) {
+        if (search.reached_[vertex] != generation || candidate < search.distances_[vertex]) {
+            search.reached_[vertex] = generation;
+            search.distances_[vertex] = candidate;
+            search.prev_vertices_[vertex] = prev_vertex;
+            search.prev_edges_[vertex] = prev_edge;
+            search.queue_.Push(candidate, vertex);
+        }
+    };
+
+    relax(from, Weight{}, from, NO_EDGE);
+    while (!search.queue_.IsEmpty()) {
+        const auto [weight, vertex] = search.queue_.Pop();
+        if (search.settled_[vertex] == generation) {
+            continue;
+        }
+        search.settled_[vertex] = generation;
+        if (vertex == to) {
+            break;
+        }
+        const uint32_t cell = cells_[vertex];
+        const bool is_open = cell == cells_[from] || cell == cells_[to];
+        if (!is_open && entry_positions_[vertex] != NO_INDEX) {
+            const size_t exit_count = exit_offsets_[cell + 1] - exit_offsets_[cell];
+            const Weight* row = cliques_.data() + clique_offsets_[cell] + entry_positions_[vertex] * exit_count;
+            for (size_t j = exit_offsets_[cell]; j < exit_offsets_[cell + 1]; ++j, ++row) {
+                if (*row != INFINITE_WEIGHT) {
+                    relax(exits_[j], weight + *row, vertex, NO_EDGE);
+                }
+            }
+        }
+        if (is_open || exit_positions_[vertex] != NO_INDEX) {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                if (is_open || cells_[edge.to] != cell) {
+                    relax(edge.to, weight + edge.weight, vertex, edge_id);
+                }
+            }
+        }
+    }
+    if (search.settled_[to] != generation) {
+        return std::nullopt;
+    }
+
+    RouteInfo route{search.distances_[to], {}};
+    for (VertexId vertex = to; vertex != from; vertex = search.prev_vertices_[vertex]) {
+        if (search.prev_edges_[vertex] != NO_EDGE) {
+            route.edges.push_back(search.prev_edges_[vertex]);
+        }
+        else {
+            AppendCellPath(search.prev_vertices_[vertex], vertex, search, route.edges);
+        }
+    }
+    std::reverse(route.edges.begin(), route.edges.end());
+    return route;
+}
+
+template <typename Weight>
+void PartitionRouter<Weight>::AppendCellPath(VertexId from, VertexId to, Search& search, std::vector<EdgeId>& edges) const {
+    // Edges are appended from to back to from, matching BuildRoute's walk.
+    SearchCell(from, search.cell_distances_, search.cell_prev_edges_);
+    for (VertexId vertex = to; vertex != from; ) {
+        const EdgeId edge_id = search.cell_prev_edges_[cell_positions_[vertex]];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+}
+
+template <typename Weight>
+size_t PartitionRouter<Weight>::GetCellCount() const {
+    return vertex_offsets_.size() - 1;
+}
+
+template <typename Weight>
+double PartitionRouter<Weight>::GetBoundaryShare() const {
+    return boundary_share_;
+}
+
+template <typename Weight>
+memory::Usage PartitionRouter<Weight>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("partition", memory::TotalMemory(cells_) + memory::TotalMemory(cell_positions_)
+        + memory::TotalMemory(entry_positions_) + memory::TotalMemory(exit_positions_)
+        + memory::TotalMemory(vertex_offsets_) + memory::TotalMemory(cell_vertices_)
+        + memory::TotalMemory(entry_offsets_) + memory::TotalMemory(entries_)
+        + memory::TotalMemory(exit_offsets_) + memory::TotalMemory(exits_)
+        + memory::TotalMemory(clique_offsets_));
+    usage.Add("cliques", memory::TotalMemory(cliques_));
+    return usage;
+}
+
+}  // namespace graph
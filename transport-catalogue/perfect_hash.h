@@ -0,0 +1,174 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace perfect_hash {
+
+// Name -> item table over a set of names that no longer changes, built by
+// hash-and-displace: the names are split into buckets of a few keys, and
+// every bucket gets the first pilot value that sends all of its keys to free
+// slots. There are exactly as many slots as names, so a lookup reads one pilot
+// and probes one slot, then compares the name stored in the item itself.
+template <typename Item, std::pmr::string Item::*Name>
+class FrozenNameTable {
+public:
+    // Returns false and leaves the table unbuilt if the names cannot be
+    // placed, which in practice means two of them are equal.
+    bool Build(const std::vector<Item*>& items);
+    bool IsBuilt() const;
+    Item* Find(std::string_view name) const;
+    memory::Usage GetMemoryUsage() const;
+
+private:
+    static constexpr size_t KEYS_PER_BUCKET = 4;
+    static constexpr uint64_t MAX_SEEDS = 16;
+
+    static uint64_t Mix(uint64_t value);
+    uint64_t KeyHash(std::string_view name) const;
+    size_t GetBucket(uint64_t key_hash) const;
+    size_t GetSlot(uint64_t key_hash, uint32_t pilot) const;
+    bool TryBuild(const std::vector<Item*>& items);
+
+    bool built_ = false;
+    uint64_t seed_ = 0;
+    std::vector<uint32_t> pilots_;
+    std::vector<Item*> slots_;
+};
+
+template <typename Item, std::pmr::string Item::*Name>
+uint64_t FrozenNameTable<Item, Name>::Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+uint64_t FrozenNameTable<Item, Name>::KeyHash(std::string_view name) const {
+    return Mix(std::hash<std::string_view>{}(name) + seed_);
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+size_t FrozenNameTable<Item, Name>::GetBucket(uint64_t key_hash) const {
+    return (key_hash >> 32) % pilots_.size();
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+size_t FrozenNameTable<Item, Name>::GetSlot(uint64_t key_hash, uint32_t pilot) const {
+    return Mix(key_hash ^ (pilot * 0x9e3779b97f4a7c15ULL)) % slots_.size();
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+bool FrozenNameTable<Item, Name>::Build(const std::vector<Item*>& items) {
+    for (seed_ = 0; seed_ < MAX_SEEDS; ++seed_) {
+        if (TryBuild(items)) {
+            built_ = true;
+            return true;
+        }
+    }
+    built_ = false;
+    pilots_ = {};
+    slots_ = {};
+    return false;
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+bool FrozenNameTable<Item, Name>::TryBuild(const std::vector<Item*>& items) {
+    slots_.assign(items.size(), nullptr);
+    pilots_.assign(items.size() / KEYS_PER_BUCKET + 1, 0);
+    if (items.empty()) {
+        return true;
+    }
+
+    std::vector<uint64_t> hashes(items.size());
+    std::vector<uint32_t> bucket_starts(pilots_.size() + 1, 0);
+    for (size_t i = 0; i < items.size(); ++i) {
+        hashes[i] = KeyHash((*items[i]).*Name);
+        ++bucket_starts[GetBucket(hashes[i]) + 1];
+    }
+    std::partial_sum(bucket_starts.begin(), bucket_starts.end(), bucket_starts.begin());
+    std::vector<uint32_t> bucket_keys(items.size());
+    std::vector<uint32_t> fill(bucket_starts.begin(), bucket_starts.end() - 1);
+    for (size_t i = 0; i < items.size(); ++i) {
+        bucket_keys[fill[GetBucket(hashes[i])]++] = static_cast<uint32_t>(i);
+    }
+
+    // Big buckets go first, while most slots are still free.
+    std::vector<uint32_t> order(pilots_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&bucket_starts](uint32_t lhs, uint32_t rhs) {
+        return bucket_starts[lhs + 1] - bucket_starts[lhs] > bucket_starts[rhs + 1] - bucket_starts[rhs];
+    });
+    // A bucket placed late sees few free slots, so it may need about as many
+    // pilots as there are slots.
+    const uint64_t max_pilot = std::max<uint64_t>(items.size() * 16, 1 << 16);
+    std::vector<size_t> placed;
+    for (uint32_t bucket : order) {
+        const uint32_t first = bucket_starts[bucket];
+        const uint32_t last = bucket_starts[bucket + 1];
+        if (first == last) {
+            break;
+        }
+        bool found = false;
+        for (uint64_t pilot = 0; pilot < max_pilot && !found; ++pilot) {
+            placed.clear();
+            found = true;
+            for (uint32_t key = first; key < last; ++key) {
+                const size_t slot = GetSlot(hashes[bucket_keys[key]], static_cast<uint32_t>(pilot));
+                if (slots_[slot]) {
+                    found = false;
+                    break;
+                }
+                slots_[slot] = items[bucket_keys[key]];
+                placed.push_back(slot);
+            }
+            if (found) {
+                pilots_[bucket] = static_cast<uint32_t>(pilot);
+            }
+            else {
+                for (size_t slot : placed) {
+                    slots_[slot] = nullptr;
+                }
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+bool FrozenNameTable<Item, Name>::IsBuilt() const {
+    return built_;
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+Item* FrozenNameTable<Item, Name>::Find(std::string_view name) const {
+    if (slots_.empty()) {
+        return nullptr;
+    }
+    const uint64_t key_hash = KeyHash(name);
+    Item* item = slots_[GetSlot(key_hash, pilots_[GetBucket(key_hash)])];
+    return (*item).*Name == name ? item : nullptr;
+}
+
+template <typename Item, std::pmr::string Item::*Name>
+memory::Usage FrozenNameTable<Item, Name>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("pilots", memory::TotalMemory(pilots_));
+    usage.Add("slots", memory::TotalMemory(slots_));
+    return usage;
+}
+
+}
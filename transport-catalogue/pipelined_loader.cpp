@@ -0,0 +1,135 @@
+#include "pipelined_loader.h"
+#include "json_reader.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <utility>
+
+using namespace std::literals;
+
+class PipelinedLoader::Handler : public json::StreamHandler {
+public:
+  explicit Handler(PipelinedLoader& loader)
+    : loader_(loader) {}
+
+  bool IsStreamed(const std::string& key) const override {
+    return key == "base_requests"s;
+  }
+
+  void OnElement(const std::string&, json::Node element) override {
+    {
+      std::lock_guard lock(loader_.mutex_);
+      loader_.base_requests_.push_back(std::move(element));
+    }
+    loader_.changed_.notify_all();
+  }
+
+  void OnArrayEnd(const std::string&) override {
+    {
+      std::lock_guard lock(loader_.mutex_);
+      loader_.base_requests_done_ = true;
+    }
+    loader_.changed_.notify_all();
+  }
+
+  void OnValue(std::string key, json::Node value) override {
+    {
+      std::lock_guard lock(loader_.mutex_);
+      loader_.values_[std::move(key)] = std::move(value);
+    }
+    loader_.changed_.notify_all();
+  }
+
+private:
+  PipelinedLoader& loader_;
+};
+
+PipelinedLoader::PipelinedLoader(std::istream& input)
+  : parser_([this, &input] { Parse(input); }) {}
+
+PipelinedLoader::~PipelinedLoader() {
+  if (parser_.joinable()) {
+    parser_.join();
+  }
+}
+
+void PipelinedLoader::Parse(std::istream& input) {
+  try {
+    METRICS_SCOPE(metrics::Phase::JSON_LOAD);
+    TRACE_SCOPE("json_load", "pipeline");
+    Handler handler(*this);
+    json::LoadStream(input, handler);
+  }
+  catch (...) {
+    std::lock_guard lock(mutex_);
+    error_ = std::current_exception();
+  }
+  Finish();
+}
+
+void PipelinedLoader::Finish() {
+  {
+    std::lock_guard lock(mutex_);
+    base_requests_done_ = true;
+    document_done_ = true;
+  }
+  changed_.notify_all();
+}
+
+void PipelinedLoader::BuildCatalogue(transport::TransportCatalogue& catalogue) {
+  METRICS_SCOPE(metrics::Phase::PARSE_CATALOGUE);
+  TRACE_SCOPE("parse_catalogue", "pipeline");
+  std::vector<json::Node> deferred;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this] { return !base_requests_.empty() || base_requests_done_; });
+    if (base_requests_.empty()) {
+      break;
+    }
+    json::Node request = std::move(base_requests_.front());
+    base_requests_.pop_front();
+    lock.unlock();
+    if (request.AsMap().at("type"s).AsString() == "Stop"s) {
+      JSONReader::AddStop(request.AsMap(), catalogue);
+    }
+    deferred.push_back(std::move(request));
+    lock.lock();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  lock.unlock();
+
+  for (const auto& request : deferred) {
+    if (request.AsMap().at("type"s).AsString() == "Stop"s) {
+      JSONReader::AddStopDistances(request.AsMap(), catalogue);
+    }
+  }
+  for (const auto& request : deferred) {
+    if (request.AsMap().at("type"s).AsString() == "Bus"s) {
+      JSONReader::AddBus(request.AsMap(), catalogue);
+    }
+  }
+  catalogue.Finalize();
+}
+
+json::Node PipelinedLoader::WaitForValue(const std::string& key) {
+  std::unique_lock lock(mutex_);
+  changed_.wait(lock, [this, &key] { return values_.count(key) || document_done_; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  auto it = values_.find(key);
+  if (it == values_.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+json::Document PipelinedLoader::TakeDocument() {
+  parser_.join();
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  return json::Document{std::exchange(values_, {})};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "json.h"
+#include "transport_catalogue.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads the input document on its own thread while the caller builds from
+// what has been read so far. Stops go into the catalogue as soon as they are
+// parsed; distances and buses follow once base_requests is complete, since
+// they may name stops further down. The other top-level values can be waited
+// for one by one, so the router can be started from routing_settings while
+// stat_requests are still being parsed.
+class PipelinedLoader {
+public:
+  explicit PipelinedLoader(std::istream& input);
+  ~PipelinedLoader();
+
+  // Returns once every base request is in the catalogue.
+  void BuildCatalogue(transport::TransportCatalogue& catalogue);
+  // Blocks until the value under key is parsed; null if the document ends
+  // without it.
+  json::Node WaitForValue(const std::string& key);
+  // Blocks until the whole input is parsed and returns the top-level values
+  // other than base_requests.
+  json::Document TakeDocument();
+
+private:
+  class Handler;
+
+  void Parse(std::istream& input);
+  void Finish();
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<json::Node> base_requests_;
+  bool base_requests_done_ = false;
+  json::Dict values_;
+  bool document_done_ = false;
+  std::exception_ptr error_;
+  std::thread parser_;
+};
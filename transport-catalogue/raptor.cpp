@@ -0,0 +1,233 @@
+#include "raptor.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace router {
+
+    namespace {
+        const double INFINITE_TIME = std::numeric_limits<double>::infinity();
+        const uint32_t NO_ROUTE = std::numeric_limits<uint32_t>::max();
+    }
+
+    RaptorRouter::RaptorRouter(const transport::TransportCatalogue& catalogue, size_t max_rounds)
+    :max_rounds_(max_rounds)
+    {
+        for(const auto& [name, stop] : catalogue.GetAllStops()){
+            stop_ids_[stop] = static_cast<uint32_t>(stops_.size());
+            stops_.push_back(stop);
+        }
+
+        std::vector<std::vector<StopRoute>> stop_routes(stops_.size());
+        for(const auto& [name, bus] : catalogue.GetAllBuses()){
+            if(bus->trips.empty() || bus->stops.empty()){
+                continue;
+            }
+            std::vector<const transport::Stop*> traversal{bus->stops.begin(), bus->stops.end()};
+            if(!bus->is_roundtrip){
+                traversal.insert(traversal.end(), std::next(bus->stops.rbegin()), bus->stops.rend());
+            }
+            Route route{bus, static_cast<uint32_t>(route_stops_.size()), static_cast<uint32_t>(traversal.size()),
+                        static_cast<uint32_t>(stop_times_.size()), static_cast<uint32_t>(bus->trips.size())};
+            const uint32_t route_id = static_cast<uint32_t>(routes_.size());
+            for(uint32_t position = 0; position < traversal.size(); ++position){
+                const uint32_t stop_id = stop_ids_.at(traversal[position]);
+                route_stops_.push_back(stop_id);
+                stop_routes[stop_id].push_back({route_id, position});
+            }
+
+            std::vector<const transport::Trip*> trips;
+            for(const auto& trip : bus->trips){
+                trips.push_back(&trip);
+            }
+            std::sort(trips.begin(), trips.end(), [](const transport::Trip* lhs, const transport::Trip* rhs){
+                return lhs->times.front() < rhs->times.front();
+            });
+            for(const auto* trip : trips){
+                stop_times_.insert(stop_times_.end(), trip->times.begin(), trip->times.end());
+            }
+            routes_.push_back(route);
+        }
+
+        stop_routes_begin_.reserve(stops_.size() + 1);
+        for(const auto& served : stop_routes){
+            stop_routes_begin_.push_back(static_cast<uint32_t>(stop_routes_.size()));
+            stop_routes_.insert(stop_routes_.end(), served.begin(), served.end());
+        }
+        stop_routes_begin_.push_back(static_cast<uint32_t>(stop_routes_.size()));
+    }
+
+    memory::Usage RaptorRouter::GetMemoryUsage() const {
+        memory::Usage usage;
+        usage.Add("raptor_stops", memory::TotalMemory(stops_) + memory::TotalMemory(stop_ids_));
+        usage.Add("raptor_routes", memory::TotalMemory(routes_) + memory::TotalMemory(route_stops_));
+        usage.Add("raptor_stop_times", memory::TotalMemory(stop_times_));
+        usage.Add("raptor_stop_routes", memory::TotalMemory(stop_routes_begin_) + memory::TotalMemory(stop_routes_));
+        return usage;
+    }
+
+    double RaptorRouter::GetTime(const Route& route, uint32_t trip, uint32_t position) const {
+        return stop_times_[route.first_time + trip * route.stop_count + position];
+    }
+
+    std::optional<uint32_t> RaptorRouter::FindEarliestTrip(const Route& route, uint32_t position, double time) const {
+        // Trips do not overtake, so the times at one position are sorted too.
+        uint32_t left = 0;
+        uint32_t right = route.trip_count;
+        while(left < right){
+            const uint32_t middle = left + (right - left) / 2;
+            if(GetTime(route, middle, position) < time){
+                left = middle + 1;
+            }
+            else{
+                right = middle;
+            }
+        }
+        if(left == route.trip_count){
+            return std::nullopt;
+        }
+        return left;
+    }
+
+    RaptorRouter::Search::Search(const RaptorRouter& router)
+    :labels_((router.max_rounds_ + 1) * router.stops_.size(), Label{INFINITE_TIME, NO_ROUTE, 0, 0, 0, 0})
+    ,best_(router.stops_.size(), INFINITE_TIME)
+    ,best_generations_(router.stops_.size(), 0)
+    ,is_marked_(router.stops_.size(), false)
+    ,queue_positions_(router.routes_.size(), NO_ROUTE)
+    {
+    }
+
+    const RaptorRouter::Label& RaptorRouter::GetLabel(const Search& search, size_t index) {
+        static const Label EMPTY_LABEL{INFINITE_TIME, NO_ROUTE, 0, 0, 0, 0};
+        const Label& label = search.labels_[index];
+        return label.generation == search.generation_ ? label : EMPTY_LABEL;
+    }
+
+    double RaptorRouter::GetBest(const Search& search, uint32_t stop) {
+        return search.best_generations_[stop] == search.generation_ ? search.best_[stop] : INFINITE_TIME;
+    }
+
+    std::optional<Journey> RaptorRouter::FindJourney(const transport::Stop* from, const transport::Stop* to, double departure_time,
+                                                     Search& search) const {
+        const uint32_t source = stop_ids_.at(from);
+        const uint32_t target = stop_ids_.at(to);
+        if(source == target){
+            return Journey{departure_time, departure_time, {}};
+        }
+
+        if(++search.generation_ == 0){
+            for(Label& label : search.labels_){
+                label.generation = 0;
+            }
+            std::fill(search.best_generations_.begin(), search.best_generations_.end(), 0);
+            search.generation_ = 1;
+        }
+        const uint32_t generation = search.generation_;
+        const size_t stop_count = stops_.size();
+        auto set_best = [&search, generation](uint32_t stop, double arrival){
+            search.best_[stop] = arrival;
+            search.best_generations_[stop] = generation;
+        };
+        auto mark = [&search](uint32_t stop){
+            if(!search.is_marked_[stop]){
+                search.is_marked_[stop] = true;
+                search.marked_stops_.push_back(stop);
+            }
+        };
+        search.labels_[source] = {departure_time, NO_ROUTE, 0, 0, 0, generation};
+        set_best(source, departure_time);
+        mark(source);
+
+        size_t best_round = 0;
+        for(size_t round = 1; round <= max_rounds_; ++round){
+            // Stops are scanned in id order, so ties between routes resolve
+            // the same way whatever order the stops were marked in.
+            std::sort(search.marked_stops_.begin(), search.marked_stops_.end());
+            for(uint32_t stop : search.marked_stops_){
+                search.is_marked_[stop] = false;
+                for(uint32_t i = stop_routes_begin_[stop]; i < stop_routes_begin_[stop + 1]; ++i){
+                    const auto [route, position] = stop_routes_[i];
+                    uint32_t& queue_position = search.queue_positions_[route];
+                    if(queue_position == NO_ROUTE){
+                        search.queued_routes_.push_back(route);
+                        queue_position = position;
+                    }
+                    else{
+                        queue_position = std::min(queue_position, position);
+                    }
+                }
+            }
+            search.marked_stops_.clear();
+            if(search.queued_routes_.empty()){
+                break;
+            }
+
+            const size_t previous = (round - 1) * stop_count;
+            const size_t current = round * stop_count;
+            for(uint32_t route_id : search.queued_routes_){
+                const Route& route = routes_[route_id];
+                std::optional<uint32_t> trip;
+                uint32_t board_position = 0;
+                for(uint32_t position = search.queue_positions_[route_id]; position < route.stop_count; ++position){
+                    const uint32_t stop = route_stops_[route.first_stop + position];
+                    if(trip){
+                        const double arrival = GetTime(route, *trip, position);
+                        if(arrival < std::min(GetBest(search, stop), GetBest(search, target))){
+                            search.labels_[current + stop] = {arrival, route_id, *trip, board_position, position, generation};
+                            set_best(stop, arrival);
+                            mark(stop);
+                        }
+                    }
+                    const double previous_arrival = GetLabel(search, previous + stop).arrival;
+                    if(previous_arrival < INFINITE_TIME
+                       && (!trip || previous_arrival <= GetTime(route, *trip, position))){
+                        if(auto earlier = FindEarliestTrip(route, position, previous_arrival)){
+                            if(!trip || *earlier < *trip){
+                                trip = earlier;
+                                board_position = position;
+                            }
+                        }
+                    }
+                }
+                search.queue_positions_[route_id] = NO_ROUTE;
+            }
+            search.queued_routes_.clear();
+            if(GetLabel(search, current + target).arrival < INFINITE_TIME){
+                best_round = round;
+            }
+        }
+        for(uint32_t stop : search.marked_stops_){
+            search.is_marked_[stop] = false;
+        }
+        search.marked_stops_.clear();
+
+        if(best_round == 0){
+            return std::nullopt;
+        }
+
+        Journey journey{departure_time, GetLabel(search, best_round * stop_count + target).arrival, {}};
+        uint32_t stop = target;
+        for(size_t round = best_round; round > 0; --round){
+            const Label& label = GetLabel(search, round * stop_count + stop);
+            if(label.route == NO_ROUTE){
+                continue;
+            }
+            const Route& route = routes_[label.route];
+            const uint32_t board_stop = route_stops_[route.first_stop + label.board_position];
+            const double board_time = GetTime(route, label.trip, label.board_position);
+            journey.legs.push_back({
+                route.bus->bus_name,
+                stops_[board_stop]->stop_name,
+                board_time - GetLabel(search, (round - 1) * stop_count + board_stop).arrival,
+                label.arrival - board_time,
+                static_cast<int>(label.alight_position - label.board_position)
+            });
+            stop = board_stop;
+        }
+        std::reverse(journey.legs.begin(), journey.legs.end());
+        return journey;
+    }
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "domain.h"
+#include "memory_usage.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace router {
+
+    struct JourneyLeg {
+        std::string_view bus;
+        std::string_view board_stop;
+        double wait_time;
+        double ride_time;
+        int span_count;
+    };
+
+    struct Journey {
+        double departure_time;
+        double arrival_time;
+        std::vector<JourneyLeg> legs;
+    };
+
+    // Round-based public transit routing (RAPTOR) over the buses' timetables.
+    // Round k finds the earliest arrival at every stop using at most k trips;
+    // each round scans the flat route and stop-time arrays directly, no graph
+    // is built. Trips of one bus are expected not to overtake each other.
+    class RaptorRouter {
+        struct Label {
+            double arrival;
+            uint32_t route;
+            uint32_t trip;
+            uint32_t board_position;
+            uint32_t alight_position;
+            // Query in which the label was set; older labels read as empty.
+            uint32_t generation;
+        };
+
+        public:
+        // Buffers for one query at a time, stamped per query like Dijkstra's,
+        // so a query neither allocates nor clears its round labels.
+        class Search {
+            public:
+            explicit Search(const RaptorRouter& router);
+
+            private:
+            friend class RaptorRouter;
+
+            uint32_t generation_ = 0;
+            // Round-major: one row of stops per round.
+            std::vector<Label> labels_;
+            std::vector<double> best_;
+            std::vector<uint32_t> best_generations_;
+            // Stops improved in the last round; is_marked_ is all false
+            // between queries.
+            std::vector<uint32_t> marked_stops_;
+            std::vector<bool> is_marked_;
+            // NO_ROUTE between queries.
+            std::vector<uint32_t> queue_positions_;
+            std::vector<uint32_t> queued_routes_;
+        };
+
+        explicit RaptorRouter(const transport::TransportCatalogue& catalogue, size_t max_rounds = 8);
+
+        std::optional<Journey> FindJourney(const transport::Stop* from, const transport::Stop* to, double departure_time,
+                                           Search& search) const;
+        memory::Usage GetMemoryUsage() const;
+
+        private:
+        struct Route {
+            const transport::Bus* bus;
+            uint32_t first_stop;
+            uint32_t stop_count;
+            uint32_t first_time;
+            uint32_t trip_count;
+        };
+
+        struct StopRoute {
+            uint32_t route;
+            uint32_t position;
+        };
+
+        double GetTime(const Route& route, uint32_t trip, uint32_t position) const;
+        std::optional<uint32_t> FindEarliestTrip(const Route& route, uint32_t position, double time) const;
+        static const Label& GetLabel(const Search& search, size_t index);
+        static double GetBest(const Search& search, uint32_t stop);
+
+        size_t max_rounds_;
+        std::vector<const transport::Stop*> stops_;
+        std::unordered_map<const transport::Stop*, uint32_t> stop_ids_;
+        std::vector<Route> routes_;
+        // Stops of every route, route by route.
+        std::vector<uint32_t> route_stops_;
+        // Times of every route, trip-major and sorted by departure.
+        std::vector<double> stop_times_;
+        // For each stop, the (route, position) pairs serving it, in CSR form.
+        std::vector<uint32_t> stop_routes_begin_;
+        std::vector<StopRoute> stop_routes_;
+    };
+
+}
@@ -1 +1,51 @@
-//
+#include "request_handler.h"
+
+RequestHandler::RequestHandler(const transport::TransportCatalogue& catalogue,
+                               RenderSettingsLoader render_settings,
+                               RoutingSettingsLoader routing_settings)
+  : catalogue_(catalogue)
+  , render_settings_(std::move(render_settings))
+  , routing_settings_(std::move(routing_settings)) {}
+
+RequestHandler::RequestHandler(const transport::TransportCatalogue& catalogue,
+                               RenderSettingsLoader render_settings,
+                               std::unique_ptr<router::TransportRouter> router)
+  : catalogue_(catalogue)
+  , render_settings_(std::move(render_settings))
+  , router_(std::move(router))
+  , built_router_(router_.get()) {
+  std::call_once(router_flag_, [] {});
+}
+
+const transport::TransportCatalogue& RequestHandler::GetCatalogue() const {
+  return catalogue_;
+}
+
+const renderer::MapRenderer& RequestHandler::GetRenderer() const {
+  std::call_once(renderer_flag_, [this] {
+    renderer_ = std::make_unique<renderer::MapRenderer>(render_settings_(), fragments_);
+  });
+  return *renderer_;
+}
+
+const router::TransportRouter& RequestHandler::GetRouter() const {
+  std::call_once(router_flag_, [this] {
+    router_ = std::make_unique<router::TransportRouter>(catalogue_, routing_settings_());
+    built_router_.store(router_.get(), std::memory_order_release);
+  });
+  return *router_;
+}
+
+const router::TransportRouter* RequestHandler::FindRouter() const {
+  return built_router_.load(std::memory_order_acquire);
+}
+
+void RequestHandler::PrepareRouter() {
+  router_build_ = std::async(std::launch::async, [this] {
+    GetRouter();
+  });
+}
+
+void RequestHandler::ShareFragments(std::shared_ptr<renderer::FragmentCache> fragments) {
+  fragments_ = std::move(fragments);
+}
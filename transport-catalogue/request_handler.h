@@ -1 +1,54 @@
-//
+#pragma once
+
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+// Gives the request batch access to the catalogue and builds the router and
+// the renderer only when a request first needs them. Settings are read by
+// the given loaders at that moment too, so a batch of Stop and Bus requests
+// never parses routing or render settings nor builds the graph.
+class RequestHandler {
+public:
+  using RenderSettingsLoader = std::function<renderer::RenderSettings()>;
+  using RoutingSettingsLoader = std::function<router::RoutingSettings()>;
+
+  RequestHandler(const transport::TransportCatalogue& catalogue,
+                 RenderSettingsLoader render_settings,
+                 RoutingSettingsLoader routing_settings);
+  // Serves routes from a router built elsewhere for the same catalogue.
+  RequestHandler(const transport::TransportCatalogue& catalogue,
+                 RenderSettingsLoader render_settings,
+                 std::unique_ptr<router::TransportRouter> router);
+
+  const transport::TransportCatalogue& GetCatalogue() const;
+  // Both are safe to call from several threads; the first caller builds.
+  const renderer::MapRenderer& GetRenderer() const;
+  const router::TransportRouter& GetRouter() const;
+  // nullptr while not built yet.
+  const router::TransportRouter* FindRouter() const;
+  // Starts building the router on another thread; GetRouter then waits for
+  // that build instead of starting its own.
+  void PrepareRouter();
+  // Lets the renderer reuse fragments drawn for an earlier catalogue under
+  // the same render settings. Has to be called before the renderer is built.
+  void ShareFragments(std::shared_ptr<renderer::FragmentCache> fragments);
+
+private:
+  const transport::TransportCatalogue& catalogue_;
+  RenderSettingsLoader render_settings_;
+  RoutingSettingsLoader routing_settings_;
+  std::shared_ptr<renderer::FragmentCache> fragments_;
+  mutable std::once_flag renderer_flag_;
+  mutable std::unique_ptr<renderer::MapRenderer> renderer_;
+  mutable std::once_flag router_flag_;
+  mutable std::unique_ptr<router::TransportRouter> router_;
+  mutable std::atomic<const router::TransportRouter*> built_router_ = nullptr;
+  std::future<void> router_build_;
+};
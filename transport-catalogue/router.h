@@ -6,6 +6,7 @@
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <memory_resource>
 #include <optional>
 #include <stdexcept>
 #include <unordered_map>
@@ -20,7 +21,7 @@ private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    explicit Router(const Graph& graph, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     struct RouteInfo {
         Weight weight;
@@ -28,13 +29,14 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    memory::Usage GetMemoryUsage() const;
 
 private:
     struct RouteInternalData {
         Weight weight;
         std::optional<EdgeId> prev_edge;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    using RoutesInternalData = std::pmr::vector<std::pmr::vector<std::optional<RouteInternalData>>>;
 
     void InitializeRoutesInternalData(const Graph& graph) {
         const size_t vertex_count = graph.GetVertexCount();
@@ -81,10 +83,11 @@ private:
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, std::pmr::memory_resource* resource)
     : graph_(graph)
     , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+                            std::pmr::vector<std::optional<RouteInternalData>>(graph.GetVertexCount(), resource),
+                            resource)
 {
     InitializeRoutesInternalData(graph);
 
@@ -114,4 +117,11 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     return RouteInfo{weight, std::move(edges)};
 }
 
+template <typename Weight>
+memory::Usage Router<Weight>::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("routes_internal_data", memory::TotalMemory(routes_internal_data_));
+    return usage;
+}
+
 }  // namespace graph
@@ -0,0 +1,165 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace snapshot {
+
+  Snapshot::Snapshot(std::unique_ptr<transport::TransportCatalogue> catalogue,
+                     renderer::RenderSettings render_settings,
+                     router::RoutingSettings routing_settings)
+    : catalogue_(std::move(catalogue))
+    , render_settings_(std::move(render_settings))
+    , handler_(*catalogue_,
+               [this] { return render_settings_; },
+               [routing_settings] { return routing_settings; }) {}
+
+  Snapshot::Snapshot(std::shared_ptr<const transport::TransportCatalogue> catalogue,
+                     renderer::RenderSettings render_settings,
+                     std::unique_ptr<router::TransportRouter> router)
+    : catalogue_(std::move(catalogue))
+    , render_settings_(std::move(render_settings))
+    , handler_(*catalogue_,
+               [this] { return render_settings_; },
+               std::move(router)) {}
+
+  std::unique_ptr<Snapshot> Snapshot::Load(std::istream& input, JSONReader::Format format, const Snapshot* previous) {
+    JSONReader reader(input, format);
+    auto catalogue = std::make_unique<transport::TransportCatalogue>();
+    reader.ParseCatalogue(*catalogue);
+    auto snapshot = std::make_unique<Snapshot>(std::move(catalogue),
+                                               reader.ParseRenderSettings(),
+                                               JSONReader::FillRoutingSettings(reader.GetRoutingSettings().AsMap()));
+    snapshot->handler_.GetRouter();
+    if (previous) {
+      const auto& fragments = previous->handler_.GetRenderer().GetFragmentCache();
+      snapshot->handler_.ShareFragments(fragments);
+      // Entries of buses and stops that left the feed would never be looked
+      // up again.
+      const transport::TransportCatalogue& current = *snapshot->catalogue_;
+      for (const auto& [name, bus] : previous->catalogue_->GetAllBuses()) {
+        if (!current.FindBus(name)) {
+          fragments->InvalidateBus(name);
+        }
+      }
+      for (const auto& [name, stop] : previous->catalogue_->GetAllStops()) {
+        if (!current.FindStop(name)) {
+          fragments->InvalidateStop(name);
+        }
+      }
+    }
+    snapshot->handler_.GetRenderer();
+    return snapshot;
+  }
+
+  const RequestHandler& Snapshot::GetHandler() const {
+    return handler_;
+  }
+
+  std::unique_ptr<Snapshot> Snapshot::WithTimeSettings(const router::TimeSettings& time_settings) const {
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(catalogue_, render_settings_,
+                                                    handler_.GetRouter().WithTimeSettings(time_settings)));
+    snapshot->handler_.ShareFragments(handler_.GetRenderer().GetFragmentCache());
+    snapshot->handler_.GetRenderer();
+    return snapshot;
+  }
+
+  SnapshotRegistry::Reader::Reader(std::atomic<uint64_t>* slot, const Snapshot* snapshot)
+    : slot_(slot)
+    , snapshot_(snapshot) {}
+
+  SnapshotRegistry::Reader::Reader(Reader&& other) noexcept
+    : slot_(std::exchange(other.slot_, nullptr))
+    , snapshot_(std::exchange(other.snapshot_, nullptr)) {}
+
+  SnapshotRegistry::Reader::~Reader() {
+    if (slot_) {
+      slot_->store(IDLE);
+    }
+  }
+
+  const Snapshot& SnapshotRegistry::Reader::operator*() const {
+    return *snapshot_;
+  }
+
+  const Snapshot* SnapshotRegistry::Reader::operator->() const {
+    return snapshot_;
+  }
+
+  SnapshotRegistry::SnapshotRegistry(std::unique_ptr<const Snapshot> initial)
+    : current_(initial.get())
+    , current_owner_(std::move(initial)) {}
+
+  SnapshotRegistry::~SnapshotRegistry() {
+    SlotBlock* block = slots_.next.load();
+    while (block) {
+      delete std::exchange(block, block->next.load());
+    }
+  }
+
+  SnapshotRegistry::Reader SnapshotRegistry::Acquire() const {
+    // Threads start looking at different slots so that they rarely collide.
+    thread_local const size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    SlotBlock* block = &slots_;
+    while (true) {
+      for (size_t attempt = 0; attempt < READER_SLOTS; ++attempt) {
+        Slot& slot = block->slots[(hint + attempt) % READER_SLOTS];
+        uint64_t expected = IDLE;
+        // The epoch may be stale by the time the slot shows it. That only
+        // keeps more snapshots alive, never fewer.
+        if (slot.epoch.compare_exchange_strong(expected, epoch_.load())) {
+          return Reader(&slot.epoch, current_.load());
+        }
+      }
+      SlotBlock* next = block->next.load();
+      if (!next) {
+        // Of readers appending at once, one block wins and the others are
+        // dropped before anyone sees them.
+        auto added = std::make_unique<SlotBlock>();
+        if (block->next.compare_exchange_strong(next, added.get())) {
+          next = added.release();
+        }
+      }
+      block = next;
+    }
+  }
+
+  void SnapshotRegistry::Publish(std::unique_ptr<const Snapshot> snapshot) {
+    std::lock_guard lock(writer_mutex_);
+    std::unique_ptr<const Snapshot> old = std::exchange(current_owner_, std::move(snapshot));
+    current_.store(current_owner_.get());
+    // A reader whose slot shows this epoch or later loaded the pointer
+    // after the store above.
+    const uint64_t epoch = epoch_.fetch_add(1) + 1;
+    if (old) {
+      retired_.push_back({std::move(old), epoch});
+    }
+    ReclaimLocked();
+  }
+
+  std::future<void> SnapshotRegistry::PublishAsync(std::function<std::unique_ptr<const Snapshot>()> build) {
+    return std::async(std::launch::async, [this, build = std::move(build)] {
+      Publish(build());
+    });
+  }
+
+  size_t SnapshotRegistry::Reclaim() {
+    std::lock_guard lock(writer_mutex_);
+    return ReclaimLocked();
+  }
+
+  size_t SnapshotRegistry::ReclaimLocked() {
+    uint64_t oldest_reader = IDLE;
+    for (const SlotBlock* block = &slots_; block; block = block->next.load()) {
+      for (const Slot& slot : block->slots) {
+        oldest_reader = std::min(oldest_reader, slot.epoch.load());
+      }
+    }
+    auto still_visible = std::partition(retired_.begin(), retired_.end(), [oldest_reader](const Retired& retired) {
+      return retired.epoch > oldest_reader;
+    });
+    retired_.erase(still_visible, retired_.end());
+    return retired_.size();
+  }
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace snapshot {
+
+  // Catalogue, router and renderer for one feed. Built completely before it
+  // is published and never modified afterwards.
+  class Snapshot {
+    public:
+    Snapshot(std::unique_ptr<transport::TransportCatalogue> catalogue,
+             renderer::RenderSettings render_settings,
+             router::RoutingSettings routing_settings);
+
+    // Builds from the base requests and settings of a whole input document;
+    // the router and the renderer are built here rather than on first use.
+    // Given the snapshot it is going to replace, the map reuses that one's
+    // fragments for every bus and stop that is drawn the same.
+    static std::unique_ptr<Snapshot> Load(std::istream& input, JSONReader::Format format = JSONReader::Format::JSON,
+                                          const Snapshot* previous = nullptr);
+
+    const RequestHandler& GetHandler() const;
+    // A snapshot of the same feed under another bus_wait_time and
+    // bus_velocity. It shares this one's catalogue and gets a router
+    // re-customized from this one's, so publishing it is how new time
+    // settings reach requests without rebuilding from the input.
+    std::unique_ptr<Snapshot> WithTimeSettings(const router::TimeSettings& time_settings) const;
+
+    private:
+    Snapshot(std::shared_ptr<const transport::TransportCatalogue> catalogue,
+             renderer::RenderSettings render_settings,
+             std::unique_ptr<router::TransportRouter> router);
+
+    std::shared_ptr<const transport::TransportCatalogue> catalogue_;
+    renderer::RenderSettings render_settings_;
+    RequestHandler handler_;
+  };
+
+  // Holds the snapshot requests are served from and swaps it without
+  // stopping them. A reader announces the epoch it started in through a
+  // slot, then loads the current pointer; neither step takes a lock or waits
+  // for another reader. A replaced snapshot is retired with the epoch of its
+  // replacement and released by the writer once every busy slot shows a
+  // later epoch, i.e. once the readers that could have loaded it are gone.
+  // Readers never release a snapshot themselves, so tearing one down never
+  // lands on a request thread.
+  //
+  // The command-line tool answers one document and exits, so it has nothing
+  // to swap; the registry is for a long-running server embedding the
+  // library, and tests/snapshot_stress_test.cpp drives it the way one would.
+  class SnapshotRegistry {
+    public:
+    // Slots per block. A reader that finds every slot of a block busy moves
+    // on to the next block, and the first one to run out of blocks appends
+    // a new block with a compare-and-swap. Blocks are kept until the
+    // registry is destroyed, so the slots grow to the most readers ever
+    // active at once.
+    static constexpr size_t READER_SLOTS = 128;
+
+    class Reader {
+      public:
+      Reader(Reader&& other) noexcept;
+      Reader& operator=(Reader&&) = delete;
+      ~Reader();
+
+      const Snapshot& operator*() const;
+      const Snapshot* operator->() const;
+
+      private:
+      friend class SnapshotRegistry;
+      Reader(std::atomic<uint64_t>* slot, const Snapshot* snapshot);
+
+      std::atomic<uint64_t>* slot_;
+      const Snapshot* snapshot_;
+    };
+
+    explicit SnapshotRegistry(std::unique_ptr<const Snapshot> initial);
+    SnapshotRegistry(const SnapshotRegistry&) = delete;
+    SnapshotRegistry& operator=(const SnapshotRegistry&) = delete;
+    // No reader holding a slot may outlive the registry.
+    ~SnapshotRegistry();
+
+    // Pins the current snapshot for as long as the returned reader lives.
+    Reader Acquire() const;
+    // Makes snapshot current for new readers; the old one stays valid for
+    // the readers already holding it.
+    void Publish(std::unique_ptr<const Snapshot> snapshot);
+    // Builds a snapshot on another thread and publishes it when done.
+    std::future<void> PublishAsync(std::function<std::unique_ptr<const Snapshot>()> build);
+    // Releases the retired snapshots no reader can still hold and returns
+    // how many are left waiting. Publish calls it too.
+    size_t Reclaim();
+
+    private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    size_t ReclaimLocked();
+
+    struct alignas(64) Slot {
+      std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    struct SlotBlock {
+      std::array<Slot, READER_SLOTS> slots;
+      std::atomic<SlotBlock*> next{nullptr};
+    };
+
+    struct Retired {
+      std::unique_ptr<const Snapshot> snapshot;
+      uint64_t epoch;
+    };
+
+    std::atomic<const Snapshot*> current_;
+    // Owns the current snapshot; only touched by the writer.
+    std::unique_ptr<const Snapshot> current_owner_;
+    std::atomic<uint64_t> epoch_{0};
+    mutable SlotBlock slots_;
+    std::mutex writer_mutex_;
+    std::vector<Retired> retired_;
+  };
+
+}
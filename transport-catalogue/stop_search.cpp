@@ -0,0 +1,129 @@
+#include "stop_search.h"
+
+#include <algorithm>
+#include <string>
+
+namespace transport {
+
+  namespace {
+
+    size_t CodePointLength(char lead) {
+      const unsigned char byte = static_cast < unsigned char > (lead);
+      if (byte >= 0xf0) return 4;
+      if (byte >= 0xe0) return 3;
+      if (byte >= 0xc0) return 2;
+      return 1;
+    }
+
+    std::vector < std::string_view > SplitCodePoints(std::string_view text) {
+      std::vector < std::string_view > result;
+      for (size_t pos = 0; pos < text.size();) {
+        const size_t length = std::min(CodePointLength(text[pos]), text.size() - pos);
+        result.push_back(text.substr(pos, length));
+        pos += length;
+      }
+      return result;
+    }
+
+  }
+
+  // Depth-first walk over the sorted names. A node is a range of stops
+  // sharing their first depth bytes; its children split the range by the
+  // next code point. Each level extends one row of the Levenshtein table
+  // against the query, and a branch is dropped once the whole row exceeds
+  // the bound.
+  struct StopSearchIndex::Walk {
+    const std::vector < const Stop * > & stops;
+    std::vector < std::string_view > query;
+    int max_distance;
+    // One table row per walk level, so the walk allocates nothing per node.
+    std::vector < int > rows;
+    std::vector < std::pair < const Stop *, int >> found;
+
+    void Visit(size_t first, size_t last, size_t depth, size_t level) {
+      const size_t width = query.size() + 1;
+      if (rows.size() < (level + 2) * width) {
+        rows.resize((level + 2) * width);
+      }
+      const int * row = rows.data() + level * width;
+      int * next = rows.data() + (level + 1) * width;
+      if (stops[first] -> stop_name.size() == depth) {
+        if (row[width - 1] <= max_distance) {
+          found.emplace_back(stops[first], row[width - 1]);
+        }
+        ++first;
+      }
+      while (first < last) {
+        const std::pmr::string & name = stops[first] -> stop_name;
+        const std::string_view code_point = std::string_view(name).substr(depth, CodePointLength(name[depth]));
+        const size_t child_last = std::partition_point(stops.begin() + first, stops.begin() + last,
+          [depth, code_point](const Stop * stop) {
+            return std::string_view(stop -> stop_name).substr(depth, code_point.size()) == code_point;
+          }) - stops.begin();
+        next[0] = row[0] + 1;
+        int best = next[0];
+        for (size_t i = 1; i < width; ++i) {
+          const int replace = row[i - 1] + (query[i - 1] == code_point ? 0 : 1);
+          next[i] = std::min({row[i] + 1, next[i - 1] + 1, replace});
+          best = std::min(best, next[i]);
+        }
+        if (best <= max_distance) {
+          Visit(first, child_last, depth + code_point.size(), level + 1);
+          row = rows.data() + level * width;
+          next = rows.data() + (level + 1) * width;
+        }
+        first = child_last;
+      }
+    }
+  };
+
+  void StopSearchIndex::Build(std::vector < const Stop * > stops) {
+    std::sort(stops.begin(), stops.end(), [](const Stop * lhs, const Stop * rhs) {
+      return lhs -> stop_name < rhs -> stop_name;
+    });
+    stops_ = std::move(stops);
+    stops_.shrink_to_fit();
+  }
+
+  std::vector < const Stop * > StopSearchIndex::FindByPrefix(std::string_view prefix, size_t limit) const {
+    auto it = std::lower_bound(stops_.begin(), stops_.end(), prefix, [](const Stop * stop, std::string_view value) {
+      return std::string_view(stop -> stop_name) < value;
+    });
+    std::vector < const Stop * > result;
+    for (; it != stops_.end() && result.size() < limit; ++it) {
+      if (std::string_view((*it) -> stop_name).substr(0, prefix.size()) != prefix) {
+        break;
+      }
+      result.push_back(*it);
+    }
+    return result;
+  }
+
+  std::vector < std::pair < const Stop *, int >> StopSearchIndex::FindSimilar(std::string_view query, int max_distance, size_t limit) const {
+    if (stops_.empty() || limit == 0) {
+      return {};
+    }
+    Walk walk {stops_, SplitCodePoints(query), max_distance, {}, {}};
+    walk.rows.resize(walk.query.size() + 1);
+    for (size_t i = 0; i < walk.rows.size(); ++i) {
+      walk.rows[i] = static_cast < int > (i);
+    }
+    walk.Visit(0, stops_.size(), 0, 0);
+    // The walk finds names in name order, so a stable sort by distance
+    // leaves equally close ones sorted by name.
+    std::stable_sort(walk.found.begin(), walk.found.end(), [](const auto & lhs, const auto & rhs) {
+      return lhs.second < rhs.second;
+    });
+    if (walk.found.size() > limit) {
+      walk.found.resize(limit);
+    }
+    return walk.found;
+  }
+
+  memory::Usage StopSearchIndex::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("stop_search", memory::TotalMemory(stops_));
+    return usage;
+  }
+
+}
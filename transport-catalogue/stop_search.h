@@ -0,0 +1,32 @@
+#pragma once
+
+#include "domain.h"
+#include "memory_usage.h"
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace transport {
+
+  // Autocomplete over stop names: one array of stops sorted by name, which
+  // also serves as an implicit trie for the edit-distance search. Distances
+  // count Unicode code points, not bytes.
+  class StopSearchIndex {
+    public:
+    void Build(std::vector < const Stop * > stops);
+
+    // Up to limit stops whose names start with prefix, in name order.
+    std::vector < const Stop * > FindByPrefix(std::string_view prefix, size_t limit) const;
+    // Up to limit stops within max_distance edits of query, closest first
+    // and then in name order.
+    std::vector < std::pair < const Stop *, int >> FindSimilar(std::string_view query, int max_distance, size_t limit) const;
+    memory::Usage GetMemoryUsage() const;
+
+    private:
+    struct Walk;
+
+    std::vector < const Stop * > stops_;
+  };
+
+}
@@ -158,12 +158,24 @@ namespace svg {
   }
 
   void Document::Render(std::ostream & out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+    RenderHeader(out);
+    RenderObjects(out);
+    RenderFooter(out);
+  }
+
+  void Document::RenderObjects(std::ostream & out) const {
     RenderContext ctx { out, 2, 2};
     for (const auto& obj : objects_) {
       obj -> Render(ctx);
     }
+  }
+
+  void Document::RenderHeader(std::ostream & out) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+  }
+
+  void Document::RenderFooter(std::ostream & out) {
     out << "</svg>"sv;
   }
 }
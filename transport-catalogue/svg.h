@@ -282,6 +282,9 @@ namespace svg {
   class Document: public ObjectContainer {
     public: void AddPtr(std::unique_ptr < Object > && obj) override;
     void Render(std::ostream & out) const;
+    void RenderObjects(std::ostream & out) const;
+    static void RenderHeader(std::ostream & out);
+    static void RenderFooter(std::ostream & out);
 
     private: std::vector < std::unique_ptr < Object >> objects_;
   };
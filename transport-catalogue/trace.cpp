@@ -0,0 +1,115 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+  namespace {
+
+    constexpr size_t BUFFER_CAPACITY = 1 << 14;
+
+    struct ThreadBuffer {
+      uint32_t thread_id = 0;
+      std::atomic <uint64_t> written {0};
+      std::array <Event, BUFFER_CAPACITY> events;
+    };
+
+    std::atomic <bool> enabled {false};
+
+    // Buffers outlive their threads, so events from finished workers are
+    // still there when the trace is written.
+    struct Registry {
+      std::mutex mutex;
+      std::vector <std::unique_ptr <ThreadBuffer>> buffers;
+    };
+
+    Registry& GetRegistry() {
+      static Registry registry;
+      return registry;
+    }
+
+    ThreadBuffer& GetThreadBuffer() {
+      thread_local ThreadBuffer* buffer = [] {
+        Registry& registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.buffers.push_back(std::make_unique <ThreadBuffer> ());
+        registry.buffers.back() -> thread_id = static_cast <uint32_t> (registry.buffers.size());
+        return registry.buffers.back().get();
+      }();
+      return *buffer;
+    }
+
+    uint64_t NowNs() {
+      static const auto start = std::chrono::steady_clock::now();
+      return std::chrono::duration_cast <std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start).count();
+    }
+
+    void WriteEscaped(std::ostream& out, const char* text) {
+      for (; *text; ++text) {
+        const char c = *text;
+        if (c == '"' || c == '\\') out.put('\\');
+        if (static_cast <unsigned char> (c) < 0x20) continue;
+        out.put(c);
+      }
+    }
+
+  }
+
+  void Enable() {
+    NowNs();
+    enabled.store(true, std::memory_order_relaxed);
+  }
+
+  bool IsEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  void Record(const char* name, const char* category, char phase, std::string_view detail) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % BUFFER_CAPACITY];
+    event.name = name;
+    event.category = category;
+    event.phase = phase;
+    event.timestamp_ns = NowNs();
+    const size_t length = std::min(detail.size(), DETAIL_SIZE - 1);
+    std::copy_n(detail.data(), length, event.detail);
+    event.detail[length] = '\0';
+    buffer.written.store(index + 1, std::memory_order_release);
+  }
+
+  void WriteChromeTrace(std::ostream& out) {
+    Registry& registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (const auto& buffer : registry.buffers) {
+      const uint64_t written = buffer -> written.load(std::memory_order_acquire);
+      const uint64_t begin = written > BUFFER_CAPACITY ? written - BUFFER_CAPACITY : 0;
+      for (uint64_t index = begin; index < written; ++index) {
+        const Event& event = buffer -> events[index % BUFFER_CAPACITY];
+        out << (first ? "\n" : ",\n") << "{\"name\": \"";
+        WriteEscaped(out, event.name);
+        out << "\", \"cat\": \"";
+        WriteEscaped(out, event.category);
+        out << "\", \"ph\": \"" << event.phase << "\", \"ts\": " << event.timestamp_ns / 1000 << '.'
+            << (event.timestamp_ns % 1000) / 100 << (event.timestamp_ns % 100) / 10 << event.timestamp_ns % 10
+            << ", \"pid\": 1, \"tid\": " << buffer -> thread_id;
+        if (event.phase == 'B' && event.detail[0]) {
+          out << ", \"args\": {\"detail\": \"";
+          WriteEscaped(out, event.detail);
+          out << "\"}";
+        }
+        out << "}";
+        first = false;
+      }
+    }
+    out << "\n]}" << std::endl;
+  }
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+// Build with -DTRANSPORT_TRACING=0 to compile the probes out entirely. When
+// compiled in, a probe costs one relaxed load until Enable() is called.
+#ifndef TRANSPORT_TRACING
+#define TRANSPORT_TRACING 1
+#endif
+
+namespace trace {
+
+  inline constexpr size_t DETAIL_SIZE = 96;
+
+  struct Event {
+    const char* name;
+    const char* category;
+    char phase;
+    uint64_t timestamp_ns;
+    char detail[DETAIL_SIZE];
+  };
+
+  void Enable();
+  bool IsEnabled();
+  // Events go into a ring buffer owned by the calling thread; only that
+  // thread writes it, so recording takes no lock. A full buffer overwrites
+  // its oldest events.
+  void Record(const char* name, const char* category, char phase, std::string_view detail = {});
+  // Writes every buffered event as Chrome trace JSON, loadable in
+  // chrome://tracing or Perfetto. Call once recording threads are done.
+  void WriteChromeTrace(std::ostream& out);
+
+  class Scope {
+    public:
+      Scope(const char* name, const char* category, std::string_view detail = {})
+      : name_(name), category_(category), active_(IsEnabled()) {
+        if (active_) Record(name_, category_, 'B', detail);
+      }
+
+      ~Scope() {
+        if (active_) Record(name_, category_, 'E');
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator = (const Scope&) = delete;
+
+    private:
+      const char* name_;
+      const char* category_;
+      bool active_;
+  };
+
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#if TRANSPORT_TRACING
+#define TRACE_SCOPE(name, category) ::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__) {name, category}
+#define TRACE_SCOPE_DETAIL(name, category, detail) ::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__) {name, category, detail}
+#else
+#define TRACE_SCOPE(name, category) static_cast <void> (0)
+#define TRACE_SCOPE_DETAIL(name, category, detail) static_cast <void> (0)
+#endif
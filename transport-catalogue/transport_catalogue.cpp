@@ -2,24 +2,66 @@
 
 namespace transport {
 
+  size_t DynamicMemory(const Stop& stop) {
+    return memory::DynamicMemory(stop.stop_name) + memory::DynamicMemory(stop.buses);
+  }
+
+  size_t DynamicMemory(const Bus& bus) {
+    size_t trips = memory::DynamicMemory(bus.trips);
+    for (const auto& trip : bus.trips) trips += memory::DynamicMemory(trip.times);
+    return memory::DynamicMemory(bus.bus_name) + memory::DynamicMemory(bus.stops) + trips;
+  }
+
+  TransportCatalogue::TransportCatalogue(std::pmr::memory_resource* resource)
+    : stops_distance_(resource)
+    , stops_(resource)
+    , buses_(resource) {}
+
+  memory::Usage TransportCatalogue::GetMemoryUsage() const {
+    memory::Usage usage;
+    usage.Add("stops", memory::TotalMemory(stops_));
+    usage.Add("buses", memory::TotalMemory(buses_));
+    usage.Add("stopname_to_stop", memory::TotalMemory(stopname_to_stop) + stop_names_.GetMemoryUsage().Total());
+    usage.Add("busname_to_bus", memory::TotalMemory(busname_to_bus) + bus_names_.GetMemoryUsage().Total());
+    usage.Add("stops_distance", memory::TotalMemory(stops_distance_));
+    for (auto& part : stop_search_.GetMemoryUsage().parts) {
+      usage.Add(std::move(part.first), part.second);
+    }
+    return usage;
+  }
+
   void TransportCatalogue::AddStop(std::string_view stop_name, const geo::Coordinates coordinates) {
-    stops_.push_back({std::string(stop_name), coordinates, {}});
+    if (stop_names_.IsBuilt()) throw std::logic_error("catalogue is finalized");
+    std::pmr::memory_resource* resource = stops_.get_allocator().resource();
+    stops_.push_back({std::pmr::string(stop_name, resource), coordinates, std::pmr::set <std::pmr::string>(resource)});
     stopname_to_stop[stops_.back().stop_name] = & stops_.back();
   }
 
-  void TransportCatalogue::AddBus(std::string_view bus_name, const std::vector <Stop*> stops, bool is_roundtrip) {
-    buses_.push_back({std::string(bus_name), stops, is_roundtrip});
+  void TransportCatalogue::AddBus(std::string_view bus_name, const std::vector <Stop*> stops, bool is_roundtrip, std::vector <Trip> trips) {
+    if (bus_names_.IsBuilt()) throw std::logic_error("catalogue is finalized");
+    const size_t traversal_size = is_roundtrip ? stops.size() : stops.size() * 2 - 1;
+    for (const auto& trip : trips) {
+      if (trip.times.size() != traversal_size) throw std::invalid_argument("trip does not match bus stops");
+    }
+    std::pmr::memory_resource* resource = buses_.get_allocator().resource();
+    std::pmr::vector <Trip> bus_trips(resource);
+    bus_trips.reserve(trips.size());
+    for (const auto& trip : trips) {
+      bus_trips.push_back({std::pmr::vector <double>(trip.times.begin(), trip.times.end(), resource)});
+    }
+    buses_.push_back({std::pmr::string(bus_name, resource), std::pmr::vector <Stop*>(stops.begin(), stops.end(), resource), is_roundtrip, std::move(bus_trips)});
     busname_to_bus[buses_.back().bus_name] = &buses_.back();
     for (const auto& stop: stops) {
       for (auto& stop_: stops_) {
         if (stop_.stop_name == stop -> stop_name) {
-          stop_.buses.insert(std::string(bus_name));
+          stop_.buses.emplace(bus_name);
         }
       }
     }
   }
 
   Stop* TransportCatalogue::FindStop(std::string_view stop_name) const {
+    if (stop_names_.IsBuilt()) return stop_names_.Find(stop_name);
     auto it = stopname_to_stop.find(stop_name);
     if (it != nullptr) {
       return it -> second;
@@ -28,6 +70,7 @@ namespace transport {
   }
 
   Bus* TransportCatalogue::FindBus(std::string_view bus_name) const {
+    if (bus_names_.IsBuilt()) return bus_names_.Find(bus_name);
     auto it = busname_to_bus.find(bus_name);
     if (it != nullptr) {
       return it -> second;
@@ -47,32 +90,63 @@ namespace transport {
 
   int TransportCatalogue::GetUniqueStops(std::string_view bus_name) const {
     std::unordered_set < transport::Stop*> unique_stops;
-    for (const auto& stop: busname_to_bus.at(bus_name) -> stops) {
+    const Bus* bus = FindBus(bus_name);
+    if (!bus) throw std::out_of_range("bus not found");
+    for (const auto& stop: bus -> stops) {
       unique_stops.insert(stop);
     }
     return unique_stops.size();
   }
 
-  const std::set <std::string>& TransportCatalogue::BusesForStop(Stop* stop) const {
+  const std::pmr::set <std::pmr::string>& TransportCatalogue::BusesForStop(Stop* stop) const {
     return stop -> buses;
   }
 
   std::map < std::string_view, const Bus* > TransportCatalogue::GetAllBuses() const {
     std::map < std::string_view, const Bus* > result;
-    for (const auto & [name, bus]: busname_to_bus) {
-      result.insert({name, bus});
+    for (const Bus& bus : buses_) {
+      result[bus.bus_name] = &bus;
     }
     return result;
   }
 
   const std::map<std::string_view, const Stop*> TransportCatalogue::GetAllStops() const {
     std::map<std::string_view, const Stop*> result;
-    for(const auto& [name, stop] : stopname_to_stop){
-      result.insert({name, stop});
+    for(const Stop& stop : stops_){
+      result[stop.stop_name] = &stop;
     }
     return result;
   }
 
+  void TransportCatalogue::Finalize() {
+    std::vector <Stop*> stops;
+    stops.reserve(stops_.size());
+    for (Stop& stop : stops_) {
+      stops.push_back(&stop);
+    }
+    std::vector <Bus*> buses;
+    buses.reserve(buses_.size());
+    for (Bus& bus : buses_) {
+      buses.push_back(&bus);
+    }
+    stop_search_.Build({stops.begin(), stops.end()});
+    // A table that cannot be built leaves its map in use.
+    if (stop_names_.Build(stops)) {
+      std::unordered_map <std::string_view, Stop*>().swap(stopname_to_stop);
+    }
+    if (bus_names_.Build(buses)) {
+      std::unordered_map <std::string_view, Bus*>().swap(busname_to_bus);
+    }
+  }
+
+  std::vector <const Stop*> TransportCatalogue::FindStopsByPrefix(std::string_view prefix, size_t limit) const {
+    return stop_search_.FindByPrefix(prefix, limit);
+  }
+
+  std::vector <std::pair <const Stop*, int>> TransportCatalogue::FindSimilarStops(std::string_view query, int max_distance, size_t limit) const {
+    return stop_search_.FindSimilar(query, max_distance, limit);
+  }
+
   std::optional <transport::BusStats> TransportCatalogue::GetBusStats(const std::string bus_name) const {
     transport::BusStats result {};
     transport::Bus* bus = FindBus(bus_name);
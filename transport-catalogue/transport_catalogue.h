@@ -2,6 +2,9 @@
 
 #include "domain.h"
 #include "geo.h"
+#include "memory_usage.h"
+#include "perfect_hash.h"
+#include "stop_search.h"
 
 #include <deque>
 #include <string>
@@ -13,32 +16,50 @@
 #include <numeric>
 #include <optional>
 #include <map>
+#include <memory_resource>
 
 namespace transport {
 
+  size_t DynamicMemory(const Stop& stop);
+  size_t DynamicMemory(const Bus& bus);
+
   class TransportCatalogue {
     public:
+      // Stops, buses and distances are allocated from resource, which must
+      // outlive the catalogue. The name maps only serve loading and stay on
+      // the default resource.
+      explicit TransportCatalogue(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
       void AddStop(std::string_view stop_name, const geo::Coordinates coordinates);
       void AddBus(std::string_view bus_name,
-      const std::vector <Stop*> stops, bool is_roundtrip);
+      const std::vector <Stop*> stops, bool is_roundtrip, std::vector <Trip> trips = {});
       Stop* FindStop(std::string_view stop_name) const;
       Bus* FindBus(std::string_view bus_name) const;
-      const std::set <std::string>& BusesForStop(Stop* stop) const;
+      const std::pmr::set <std::pmr::string>& BusesForStop(Stop* stop) const;
       void AddDistance(std::pair <const Stop*, const Stop* > dist_pair, int distance);
       int FindDistance(const Stop* from, const Stop* to) const;
       int GetUniqueStops(std::string_view bus_name) const;
       std::map <std::string_view, const Bus*> GetAllBuses() const;
       const std::map<std::string_view, const Stop*> GetAllStops() const;
       std::optional <transport::BusStats> GetBusStats(const std::string bus_name) const;
+      memory::Usage GetMemoryUsage() const;
+      // Called once all stops and buses are added: builds the name search
+      // index and replaces the name maps with perfect hash tables. Nothing can
+      // be added afterwards.
+      void Finalize();
+      std::vector <const Stop*> FindStopsByPrefix(std::string_view prefix, size_t limit) const;
+      std::vector <std::pair <const Stop*, int>> FindSimilarStops(std::string_view query, int max_distance, size_t limit) const;
 
     private:
 
       std::unordered_map < std::string_view, Bus* > busname_to_bus;
-      std::unordered_map <std::pair <const Stop*, const Stop*>, int, Hasher> stops_distance_;
-      std::deque <Stop> stops_;
-      std::deque <Bus> buses_;
+      std::pmr::unordered_map <std::pair <const Stop*, const Stop*>, int, Hasher> stops_distance_;
+      std::pmr::deque <Stop> stops_;
+      std::pmr::deque <Bus> buses_;
       std::unordered_map <std::string_view, Stop* > stopname_to_stop;
+      StopSearchIndex stop_search_;
+      perfect_hash::FrozenNameTable <Stop, &Stop::stop_name> stop_names_;
+      perfect_hash::FrozenNameTable <Bus, &Bus::bus_name> bus_names_;
 
   };
 }
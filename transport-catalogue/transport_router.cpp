@@ -1,5 +1,11 @@
 #include "transport_router.h" 
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
 namespace router{
 
     void TransportRouter::AddVertexes(const transport::TransportCatalogue& catalogue){
@@ -12,9 +18,57 @@ namespace router{
         }
     }
 
-    void TransportRouter::BuildGraph(const transport::TransportCatalogue& catalogue){
+    double TransportRouter::ComputeEdgeWeight(int distance) const {
+        return ComputeEdgeWeight(distance, TimeSettings{settings_.bus_wait_time, settings_.bus_velocity});
+    }
+
+    double TransportRouter::ComputeEdgeWeight(int distance, const TimeSettings& time_settings){
         const double METERS = 1000.0;
         const double MINUTES = 60.0;
+        return (static_cast<double>(distance) / (time_settings.bus_velocity * METERS / MINUTES)) + time_settings.bus_wait_time;
+    }
+
+    template <typename Weight>
+    Weight TransportRouter::ToWeight(double minutes){
+        if constexpr(std::is_floating_point_v<Weight>){
+            return minutes;
+        }
+        else {
+            const double milliseconds = std::round(minutes * MILLISECONDS_PER_MINUTE);
+            if(!(milliseconds >= 0.0 && milliseconds <= static_cast<double>(std::numeric_limits<Weight>::max()))){
+                throw std::out_of_range("edge weight does not fit in fixed-point milliseconds");
+            }
+            return static_cast<Weight>(milliseconds);
+        }
+    }
+
+    template <typename Weight>
+    double TransportRouter::ToMinutes(Weight weight){
+        if constexpr(std::is_floating_point_v<Weight>){
+            return weight;
+        }
+        else {
+            return weight / MILLISECONDS_PER_MINUTE;
+        }
+    }
+
+    TransportRouter::EngineVariant TransportRouter::MakeEngines(const RoutingSettings& settings, size_t vertex_count,
+                                                                std::pmr::memory_resource* resource){
+        if(settings.weight_type == WeightType::FIXED_MILLISECONDS){
+            return EngineVariant{std::in_place_type<Engines<FixedWeight>>, vertex_count, resource};
+        }
+        return EngineVariant{std::in_place_type<Engines<double>>, vertex_count, resource};
+    }
+
+    void TransportRouter::AddEdge(std::string_view bus, int span_count, graph::VertexId from, graph::VertexId to, int distance){
+        std::visit([&](auto& engines){
+            using Weight = typename std::decay_t<decltype(engines)>::EdgeWeight;
+            engines.graph.AddEdge({bus, span_count, from, to, ToWeight<Weight>(ComputeEdgeWeight(distance))});
+        }, engines_);
+        edge_distances_.push_back(distance);
+    }
+
+    void TransportRouter::BuildGraph(const transport::TransportCatalogue& catalogue){
         const auto& all_buses = catalogue.GetAllBuses();
         for(const auto& [name, bus] : all_buses){
             const auto& all_stops = bus->stops;
@@ -26,61 +80,387 @@ namespace router{
                 for(size_t j = i + 1; j < bus_vertex.size(); ++j) {
                     distance +=  catalogue.FindDistance(stops_to_graph_.at(bus_vertex[j - 1]), stops_to_graph_.at(bus_vertex[j]));
                     span_count++;
-                     graph_.AddEdge({
-                    name,
-                    span_count,
-                    bus_vertex.at(i),
-                    bus_vertex.at(j),
-                    (static_cast<double>(distance) / (settings_.bus_velocity * METERS / MINUTES)) + settings_.bus_wait_time 
-                });
+                    AddEdge(name, span_count, bus_vertex.at(i), bus_vertex.at(j), distance);
 
                 if(!bus -> is_roundtrip){
                     auto back_bus_vertex = ParseBusRouteOnVertexes(all_stops.rbegin(), all_stops.rend());
                     back_distance += catalogue.FindDistance(stops_to_graph_.at(back_bus_vertex[j - 1]), stops_to_graph_.at(back_bus_vertex[j]));
-                    graph_.AddEdge({
-                    name,
-                    span_count,
-                    back_bus_vertex.at(i),
-                    back_bus_vertex.at(j),
-                    (static_cast<double>(back_distance) / (settings_.bus_velocity * METERS / MINUTES)) + settings_.bus_wait_time 
-                });
+                    AddEdge(name, span_count, back_bus_vertex.at(i), back_bus_vertex.at(j), back_distance);
                 }
             }
         }
     }
-        
+
 }
 
-    std::optional<std::vector<RouteInfo>> TransportRouter::FindRouteInfo(transport::Stop* from, transport::Stop* to) const {
-        std::optional<std::vector<RouteInfo>> result;
+    RouteView::RouteView(const TransportRouter& router, RouteEdgesPtr edges, std::optional<TimeSettings> time_settings)
+    :router_(&router)
+    ,edges_(std::move(edges))
+    ,time_settings_(time_settings){}
+
+    size_t RouteView::GetItemCount() const {
+        return edges_->size();
+    }
+
+    RouteItem RouteView::GetItem(size_t index) const {
+        if(time_settings_){
+            return router_->GetRouteItem((*edges_)[index], *time_settings_);
+        }
+        return router_->GetRouteItem((*edges_)[index]);
+    }
+
+    double RouteView::GetTotalTime() const {
+        double total_time = 0.0;
+        for(size_t i = 0; i < edges_->size(); ++i){
+            total_time += GetItem(i).time;
+        }
+        return total_time;
+    }
+
+    std::optional<RouteView> TransportRouter::FindRoute(const transport::Stop* from, const transport::Stop* to) const {
         graph::VertexId id_from = vertexes_.at(from);
         graph::VertexId id_to = vertexes_.at(to);
-        std::optional<graph::Router<double>::RouteInfo> route_info = router_ -> BuildRoute(id_from, id_to);
-        if(!route_info.has_value()){
+        RouteEdgesPtr edges;
+        if(auto cached = route_cache_.Find({id_from, id_to})){
+            edges = std::move(*cached);
+        }
+        else {
+            auto route = std::visit([this, id_from, id_to](const auto& engines){
+                return BuildRoute(engines, id_from, id_to);
+            }, engines_);
+            if(route){
+                edges = std::make_shared<const std::vector<graph::EdgeId>>(std::move(*route));
+            }
+            route_cache_.Insert({id_from, id_to}, edges);
+        }
+        if(!edges){
             return std::nullopt;
         }
-        else{
-            result.emplace();
-            result->reserve(route_info.value().edges.size());
-            int wait_time = settings_.bus_wait_time;
-            for(auto id : route_info.value().edges){
-                auto edge = graph_.GetEdge(id);
-                std::string stop_wait = std::string(GetStop(edge.from) -> stop_name);
-                result->emplace_back(RouteInfo{std::string(edge.name), edge.span_count, stop_wait, wait_time, edge.weight});
+        return RouteView(*this, std::move(edges));
+    }
+
+    std::optional<RouteView> TransportRouter::FindRoute(const transport::Stop* from, const transport::Stop* to,
+                                                        const TimeSettings& time_settings) const {
+        if(time_settings.bus_wait_time == settings_.bus_wait_time && time_settings.bus_velocity == settings_.bus_velocity){
+            return FindRoute(from, to);
+        }
+        graph::VertexId id_from = vertexes_.at(from);
+        graph::VertexId id_to = vertexes_.at(to);
+        auto route = std::visit([this, id_from, id_to, &time_settings](const auto& engines){
+            return BuildRoute(engines, id_from, id_to, time_settings);
+        }, engines_);
+        if(!route){
+            return std::nullopt;
+        }
+        return RouteView(*this, std::make_shared<const std::vector<graph::EdgeId>>(std::move(*route)), time_settings);
+    }
+
+    template <typename Weight>
+    std::optional<std::vector<graph::EdgeId>> TransportRouter::BuildRoute(const Engines<Weight>& engines, graph::VertexId from, graph::VertexId to,
+                                                                          const TimeSettings& time_settings) const {
+        auto edge_weight = [this, &time_settings](graph::EdgeId edge_id){
+            return ToWeight<Weight>(ComputeEdgeWeight(edge_distances_[edge_id], time_settings));
+        };
+        WorkspaceLease workspace = workspaces_.Take();
+        graph::Dijkstra<Weight>& search = GetSearch(*workspace, engines);
+        // Rounded fixed-point weights can undercut the scaled bounds by a
+        // millisecond, which would break the radix queue's monotone keys, so
+        // they search without a bound.
+        if constexpr(std::is_floating_point_v<Weight>){
+            if(engines.landmarks){
+                // Each weight is a ride part and a wait part, and each part
+                // changes by its own factor, so no edge gets lighter than the
+                // smaller factor times its stored weight. The stored bounds
+                // scaled by it are therefore still consistent.
+                const double ride_scale = settings_.bus_velocity / time_settings.bus_velocity;
+                const double wait_scale = settings_.bus_wait_time > 0
+                    ? static_cast<double>(time_settings.bus_wait_time) / settings_.bus_wait_time
+                    : ride_scale;
+                const double scale = std::min(ride_scale, wait_scale);
+                search.RunTowards(from, to, [&engines, to, scale](graph::VertexId vertex){
+                    const Weight bound = engines.landmarks->GetLowerBound(vertex, to);
+                    return bound == graph::Landmarks<Weight>::INFINITE_WEIGHT ? bound : bound * scale;
+                }, edge_weight);
+                return ExtractRoute(search, to);
+            }
+        }
+        search.RunTowards(from, to, [](graph::VertexId){ return Weight{}; }, edge_weight);
+        return ExtractRoute(search, to);
+    }
+
+    RouteItem TransportRouter::GetRouteItem(graph::EdgeId edge_id) const {
+        return GetRouteItem(edge_id, TimeSettings{settings_.bus_wait_time, settings_.bus_velocity});
+    }
+
+    RouteItem TransportRouter::GetRouteItem(graph::EdgeId edge_id, const TimeSettings& time_settings) const {
+        // Times are computed in minutes whatever the weight type, so fixed
+        // point does not show in the printed items.
+        return std::visit([this, edge_id, &time_settings](const auto& engines){
+            const auto& edge = engines.graph.GetEdge(edge_id);
+            return RouteItem{edge.name, GetStop(edge.from)->stop_name, edge.span_count, time_settings.bus_wait_time,
+                             ComputeEdgeWeight(edge_distances_[edge_id], time_settings)};
+        }, engines_);
+    }
+
+    template <typename Weight>
+    std::optional<std::vector<graph::EdgeId>> TransportRouter::BuildRoute(const Engines<Weight>& engines, graph::VertexId from, graph::VertexId to) const {
+        auto route_edges = [](auto route) -> std::optional<std::vector<graph::EdgeId>> {
+            if(!route){
+                return std::nullopt;
             }
+            return std::move(route->edges);
+        };
+        if(engines.dense_router){
+            return route_edges(engines.dense_router->BuildRoute(from, to));
         }
+        if(engines.router){
+            return route_edges(engines.router->BuildRoute(from, to));
+        }
+        if(engines.partition_router){
+            WorkspaceLease workspace = workspaces_.Take();
+            auto& partition = std::get<SearchBuffers<Weight>>(workspace->buffers).partition;
+            if(!partition){
+                partition = std::make_unique<typename graph::PartitionRouter<Weight>::Search>(*engines.partition_router);
+            }
+            return route_edges(engines.partition_router->BuildRoute(from, to, *partition));
+        }
+        if(engines.landmarks){
+            WorkspaceLease workspace = workspaces_.Take();
+            graph::Dijkstra<Weight>& search = GetSearch(*workspace, engines);
+            search.RunTowards(from, to, [&engines, to](graph::VertexId vertex){
+                return engines.landmarks->GetLowerBound(vertex, to);
+            });
+            return ExtractRoute(search, to);
+        }
+        ShortestPathTreePtr tree = GetShortestPathTree(engines, from);
+        if(from != to && tree->prev_edges[to] == ShortestPathTree::NO_EDGE){
+            return std::nullopt;
+        }
+        std::vector<graph::EdgeId> edges;
+        for(graph::VertexId vertex = to; vertex != from; ){
+            const uint32_t edge_id = tree->prev_edges[vertex];
+            edges.push_back(edge_id);
+            vertex = engines.graph.GetEdge(edge_id).from;
+        }
+        std::reverse(edges.begin(), edges.end());
+        return edges;
+    }
+
+    template <typename Weight>
+    std::optional<std::vector<graph::EdgeId>> TransportRouter::ExtractRoute(const graph::Dijkstra<Weight>& search, graph::VertexId to) const {
+        if(!search.GetDistance(to)){
+            return std::nullopt;
+        }
+        std::vector<graph::EdgeId> edges;
+        for(auto edge_id = search.GetPrevEdge(to); edge_id; edge_id = search.GetPrevEdge(search.GetGraph().GetEdge(*edge_id).from)){
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        return edges;
+    }
+
+    template <typename Weight>
+    ShortestPathTreePtr TransportRouter::GetShortestPathTree(const Engines<Weight>& engines, graph::VertexId from) const {
+        if(auto cached = tree_cache_.Find(from)){
+            return *cached;
+        }
+        WorkspaceLease workspace = workspaces_.Take();
+        graph::Dijkstra<Weight>& search = GetSearch(*workspace, engines);
+        search.Run(from, {});
+        auto tree = std::make_shared<ShortestPathTree>();
+        tree->prev_edges.resize(engines.graph.GetVertexCount(), ShortestPathTree::NO_EDGE);
+        for(graph::VertexId vertex = 0; vertex < engines.graph.GetVertexCount(); ++vertex){
+            if(auto edge_id = search.GetPrevEdge(vertex)){
+                tree->prev_edges[vertex] = static_cast<uint32_t>(*edge_id);
+            }
+        }
+        tree_cache_.Insert(from, tree);
+        return tree;
+    }
+
+    TravelTimeMatrix TransportRouter::ComputeTravelTimes(const std::vector<const transport::Stop*>& sources,
+                                                         const std::vector<const transport::Stop*>& targets) const {
+        std::vector<graph::VertexId> target_ids;
+        target_ids.reserve(targets.size());
+        for(const auto* stop : targets){
+            target_ids.push_back(vertexes_.at(stop));
+        }
+        TravelTimeMatrix result(sources.size(), std::vector<std::optional<double>>(targets.size()));
+        if(target_ids.empty()){
+            return result;
+        }
+        std::visit([this, &sources, &target_ids, &result](const auto& engines){
+            ComputeTravelTimeRows(engines, sources, target_ids, result);
+        }, engines_);
         return result;
     }
 
+    template <typename Weight>
+    void TransportRouter::ComputeTravelTimeRows(const Engines<Weight>& engines, const std::vector<const transport::Stop*>& sources,
+                                                const std::vector<graph::VertexId>& targets, TravelTimeMatrix& result) const {
+        auto compute_rows = [this, &engines, &sources, &targets, &result](size_t begin, size_t end){
+            WorkspaceLease workspace = workspaces_.Take();
+            graph::Dijkstra<Weight>& search = GetSearch(*workspace, engines);
+            for(size_t row = begin; row < end; ++row){
+                search.Run(vertexes_.at(sources[row]), targets);
+                for(size_t column = 0; column < targets.size(); ++column){
+                    if(const std::optional<Weight> distance = search.GetDistance(targets[column])){
+                        result[row][column] = ToMinutes(*distance);
+                    }
+                }
+            }
+        };
+
+        const size_t threads = std::min<size_t>(sources.size(), std::max(1u, std::thread::hardware_concurrency()));
+        if(threads <= 1){
+            compute_rows(0, sources.size());
+            return;
+        }
+        const size_t chunk = (sources.size() + threads - 1) / threads;
+        std::vector<std::future<void>> tasks;
+        for(size_t begin = chunk; begin < sources.size(); begin += chunk){
+            tasks.push_back(std::async(std::launch::async, compute_rows, begin, std::min(sources.size(), begin + chunk)));
+        }
+        compute_rows(0, chunk);
+        for(auto& task : tasks){
+            task.get();
+        }
+    }
+
+    template <typename Weight>
+    graph::Dijkstra<Weight>& TransportRouter::GetSearch(SearchWorkspace& workspace, const Engines<Weight>& engines){
+        auto& search = std::get<SearchBuffers<Weight>>(workspace.buffers).search;
+        if(!search){
+            search = std::make_unique<graph::Dijkstra<Weight>>(engines.graph);
+        }
+        return *search;
+    }
+
+    std::optional<Journey> TransportRouter::FindJourney(const transport::Stop* from, const transport::Stop* to, double departure_time) const {
+        WorkspaceLease workspace = workspaces_.Take();
+        auto& search = workspace->raptor;
+        if(!search){
+            search = std::make_unique<RaptorRouter::Search>(raptor_);
+        }
+        return raptor_.FindJourney(from, to, departure_time, *search);
+    }
+
+    memory::Usage TransportRouter::GetMemoryUsage() const {
+        memory::Usage usage;
+        usage.Add("vertexes", memory::TotalMemory(vertexes_) + memory::TotalMemory(stops_to_graph_));
+        std::visit([&usage](const auto& engines){
+            for(auto& part : engines.graph.GetMemoryUsage().parts){
+                usage.Add("graph_" + part.first, part.second);
+            }
+            if(engines.dense_router || engines.router){
+                for(auto& part : (engines.dense_router ? engines.dense_router->GetMemoryUsage() : engines.router->GetMemoryUsage()).parts){
+                    usage.Add(std::move(part.first), part.second);
+                }
+            }
+            if(engines.partition_router){
+                for(auto& part : engines.partition_router->GetMemoryUsage().parts){
+                    usage.Add(std::move(part.first), part.second);
+                }
+            }
+            if(engines.landmarks){
+                for(auto& part : engines.landmarks->GetMemoryUsage().parts){
+                    usage.Add(std::move(part.first), part.second);
+                }
+            }
+        }, engines_);
+        for(auto& part : raptor_.GetMemoryUsage().parts){
+            usage.Add(std::move(part.first), part.second);
+        }
+        return usage;
+    }
+
+    cache::CacheStats TransportRouter::GetRouteCacheStats() const {
+        return route_cache_.GetStats();
+    }
+
+    void TransportRouter::ClearRouteCache() const {
+        route_cache_.Clear();
+    }
+
+    void TransportRouter::Preprocess(){
+        std::visit([this](auto& engines){
+            Preprocess(engines);
+        }, engines_);
+    }
+
+    template <typename Weight>
+    void TransportRouter::Preprocess(Engines<Weight>& engines){
+        METRICS_SCOPE(metrics::Phase::ROUTER_PREPROCESS);
+        TRACE_SCOPE("router_preprocess", "pipeline");
+        engines.dense_router.reset();
+        engines.router.reset();
+        engines.landmarks.reset();
+        engines.partition_router.reset();
+        if(settings_.engine == RouteEngine::BLOCKED_ALL_PAIRS){
+            engines.dense_router = std::make_unique<graph::DenseRouter<Weight, typename Engines<Weight>::DenseWeight>>(engines.graph, settings_.precompute_threads);
+        }
+        else if(settings_.engine == RouteEngine::ALL_PAIRS){
+            engines.router = std::make_unique<graph::Router<Weight>>(engines.graph, &arena_);
+        }
+        else if(settings_.engine == RouteEngine::LANDMARKS){
+            engines.landmarks = std::make_unique<graph::Landmarks<Weight>>(engines.graph, settings_.landmark_count, settings_.precompute_threads);
+        }
+        else if(settings_.engine == RouteEngine::PARTITIONED){
+            engines.partition_router = graph::PartitionRouter<Weight>::TryBuild(engines.graph, settings_.partition_cell_size, settings_.partition_max_boundary_share, settings_.precompute_threads);
+            if(!engines.partition_router){
+                METRICS_ADD(metrics::Counter::PARTITION_FALLBACKS, 1);
+                settings_.engine = RouteEngine::SHORTEST_PATH_TREES;
+            }
+        }
+    }
+
+    TransportRouter::TransportRouter(const TransportRouter& base, const TimeSettings& time_settings)
+    :settings_(base.settings_)
+    ,stops_to_graph_(base.stops_to_graph_)
+    ,vertexes_(base.vertexes_)
+    ,engines_(MakeEngines(base.settings_, base.stops_to_graph_.size() * 2, &arena_))
+    ,edge_distances_(base.edge_distances_)
+    ,route_cache_(base.settings_.route_cache_capacity, base.settings_.route_cache_admission)
+    ,tree_cache_(base.settings_.tree_cache_capacity)
+    ,raptor_(base.raptor_)
+    {
+        settings_.bus_wait_time = time_settings.bus_wait_time;
+        settings_.bus_velocity = time_settings.bus_velocity;
+        std::visit([this, &base](auto& engines){
+            using Weight = typename std::decay_t<decltype(engines)>::EdgeWeight;
+            const Engines<Weight>& base_engines = std::get<Engines<Weight>>(base.engines_);
+            {
+                METRICS_SCOPE(metrics::Phase::GRAPH_BUILD);
+                TRACE_SCOPE("graph_build", "pipeline");
+                for(graph::EdgeId edge_id = 0; edge_id < base_engines.graph.GetEdgeCount(); ++edge_id){
+                    graph::Edge<Weight> edge = base_engines.graph.GetEdge(edge_id);
+                    edge.weight = ToWeight<Weight>(ComputeEdgeWeight(edge_distances_[edge_id]));
+                    engines.graph.AddEdge(edge);
+                }
+            }
+            if(base_engines.partition_router){
+                METRICS_SCOPE(metrics::Phase::ROUTER_CUSTOMIZE);
+                TRACE_SCOPE("router_customize", "pipeline");
+                engines.partition_router = std::make_unique<graph::PartitionRouter<Weight>>(*base_engines.partition_router, engines.graph);
+            }
+            else {
+                Preprocess(engines);
+            }
+        }, engines_);
+    }
+
+    std::unique_ptr<TransportRouter> TransportRouter::WithTimeSettings(const TimeSettings& time_settings) const {
+        return std::unique_ptr<TransportRouter>(new TransportRouter(*this, time_settings));
+    }
 
     RoutingSettings TransportRouter::GetSettings() const{
         return settings_;
     }
-    
+
     const transport::Stop* TransportRouter::GetStop(graph::VertexId id) const {
         return stops_to_graph_.at(id);
-    
+
     }
 
-    
+
 }
@@ -2,56 +2,260 @@
 
 #include "domain.h"
 #include "router.h"
+#include "dense_router.h"
 #include "transport_catalogue.h"
 #include "graph.h"
+#include "dijkstra.h"
+#include "landmarks.h"
+#include "partition_router.h"
+#include "lru_cache.h"
+#include "metrics.h"
+#include "object_pool.h"
+#include "trace.h"
+#include "raptor.h"
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 #include <map>
 #include <unordered_map>
 #include <string>
 #include <string_view>
 #include <optional>
+#include <tuple>
+#include <type_traits>
+#include <variant>
 
 namespace router {
 
+    enum class RouteEngine {
+        ALL_PAIRS,
+        BLOCKED_ALL_PAIRS,
+        // No precompute; a shortest-path tree is grown from each origin on
+        // first use and kept in a bounded LRU.
+        SHORTEST_PATH_TREES,
+        // Distances to and from landmark_count landmarks are precomputed, and
+        // each route is an A* search guided by them.
+        LANDMARKS,
+        // Cells of partition_cell_size vertices with entry-exit cliques; new
+        // wait and velocity settings only recompute the cliques. Falls back
+        // to SHORTEST_PATH_TREES when more than partition_max_boundary_share
+        // of the stops end up on cell boundaries.
+        PARTITIONED
+    };
+
+    // Type of the edge weights the engines search with. Printed times are
+    // computed in minutes from the edge distances either way.
+    enum class WeightType {
+        MINUTES,
+        // Whole milliseconds in FixedWeight: integer relaxations, a radix
+        // queue instead of a binary heap, and half-width landmark, clique and
+        // all-pairs tables.
+        FIXED_MILLISECONDS
+    };
+
+    // Rounding each edge to the nearest millisecond moves a route's total by
+    // at most half a millisecond per edge, far below the 0.001 minute (60 ms)
+    // to which times are printed; the route chosen can only differ from the
+    // MINUTES one when the two totals are within that much of each other.
+    // 32 bits of milliseconds hold routes of up to 49 days.
+    using FixedWeight = uint32_t;
+    inline constexpr double MILLISECONDS_PER_MINUTE = 60000.0;
+
     struct RoutingSettings {
         int bus_wait_time;
         double bus_velocity;
+        size_t route_cache_capacity = 4096;
+        size_t route_cache_admission = 2;
+        RouteEngine engine = RouteEngine::ALL_PAIRS;
+        size_t precompute_threads = 0;
+        size_t tree_cache_capacity = 64;
+        size_t landmark_count = 16;
+        size_t partition_cell_size = 256;
+        double partition_max_boundary_share = 0.5;
+        WeightType weight_type = WeightType::MINUTES;
         bool operator ==(RoutingSettings settings){
             return bus_wait_time == settings.bus_wait_time && bus_velocity == settings.bus_velocity;
         }
     };
 
-    struct RouteInfo{
-        std::string name;
+    // The part of RoutingSettings that edge weights depend on. A Route request
+    // may bring its own.
+    struct TimeSettings {
+        int bus_wait_time;
+        double bus_velocity;
+    };
+
+    struct RouteItem {
+        std::string_view bus;
+        std::string_view stop_wait;
         int span_count;
-        std::string stop_wait;
         int wait_time;
         double time;
     };
 
+    using RouteEdgesPtr = std::shared_ptr<const std::vector<graph::EdgeId>>;
+
+    class TransportRouter;
+
+    // A found route kept as graph edge ids. Items are assembled on access
+    // and view the names owned by the catalogue, so reading them allocates
+    // nothing; the view must not outlive its router.
+    class RouteView {
+        public:
+        RouteView(const TransportRouter& router, RouteEdgesPtr edges,
+                  std::optional<TimeSettings> time_settings = std::nullopt);
+        size_t GetItemCount() const;
+        RouteItem GetItem(size_t index) const;
+        double GetTotalTime() const;
+
+        private:
+        const TransportRouter* router_;
+        RouteEdgesPtr edges_;
+        // Set when the route was found under other settings than the router's.
+        std::optional<TimeSettings> time_settings_;
+    };
+
+    using TravelTimeMatrix = std::vector<std::vector<std::optional<double>>>;
+
+    struct ShortestPathTree {
+        static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+        // Last edge on the path from the origin, NO_EDGE for the origin itself
+        // and for unreachable vertices.
+        std::vector<uint32_t> prev_edges;
+    };
+
+    using ShortestPathTreePtr = std::shared_ptr<const ShortestPathTree>;
+    struct VertexPairHasher {
+        size_t operator()(std::pair<graph::VertexId, graph::VertexId> route) const {
+            return std::hash<graph::VertexId>()(route.first) * 37 + std::hash<graph::VertexId>()(route.second);
+        }
+    };
+
     
     class TransportRouter {
         public:
         TransportRouter(const transport::TransportCatalogue& catalogue, RoutingSettings settings)
         :settings_(settings)
+        ,engines_(MakeEngines(settings, catalogue.GetAllStops().size() * 2, &arena_))
+        ,route_cache_(settings.route_cache_capacity, settings.route_cache_admission)
+        ,tree_cache_(settings.tree_cache_capacity)
+        ,raptor_(catalogue)
         {   
-            size_t stop_count = catalogue.GetAllStops().size();
-            stops_to_graph_.resize(stop_count);
-            vertexes_.reserve(stop_count);
-            graph_ = graph::DirectedWeightedGraph<double>(stop_count  * 2);
-            AddVertexes(catalogue);
-            BuildGraph(catalogue);
-            router_ = std::make_unique<graph::Router<double>>(graph_);
+            {
+                METRICS_SCOPE(metrics::Phase::GRAPH_BUILD);
+                TRACE_SCOPE("graph_build", "pipeline");
+                size_t stop_count = catalogue.GetAllStops().size();
+                stops_to_graph_.resize(stop_count);
+                vertexes_.reserve(stop_count);
+                AddVertexes(catalogue);
+                BuildGraph(catalogue);
+                std::visit([](const auto& engines){
+                    METRICS_ADD(metrics::Counter::GRAPH_VERTICES, engines.graph.GetVertexCount());
+                    METRICS_ADD(metrics::Counter::GRAPH_EDGES, engines.graph.GetEdgeCount());
+                }, engines_);
+            }
+            Preprocess();
         }
 
-        std::optional<std::vector<RouteInfo>> FindRouteInfo(transport::Stop* from, transport::Stop* to) const;
+        // Returns nullopt when there is no route. Edge lists are memoized per
+        // (from, to) pair; the cache lives and dies with this router, which is
+        // bound to one catalogue and one set of settings.
+        std::optional<RouteView> FindRoute(const transport::Stop* from, const transport::Stop* to) const;
+        // The same under other wait and velocity settings. Edge weights are
+        // computed from the stored distances as the search reaches them, so
+        // neither the graph nor the precomputed tables are touched; only the
+        // landmark bounds are reused, scaled down to stay valid. Such routes
+        // bypass the route cache.
+        std::optional<RouteView> FindRoute(const transport::Stop* from, const transport::Stop* to,
+                                           const TimeSettings& time_settings) const;
+        RouteItem GetRouteItem(graph::EdgeId edge_id) const;
+        RouteItem GetRouteItem(graph::EdgeId edge_id, const TimeSettings& time_settings) const;
+        // One row per source, one column per target; nullopt where the target
+        // is unreachable. Each row is a single one-to-many search that stops
+        // once all targets are settled, and rows are computed in parallel.
+        TravelTimeMatrix ComputeTravelTimes(const std::vector<const transport::Stop*>& sources,
+                                            const std::vector<const transport::Stop*>& targets) const;
+        // Timetable-based journey leaving from at departure_time, using the
+        // buses' trips instead of bus_wait_time and bus_velocity.
+        std::optional<Journey> FindJourney(const transport::Stop* from, const transport::Stop* to, double departure_time) const;
         RoutingSettings GetSettings() const;
+        // A router for the same catalogue under another bus_wait_time and
+        // bus_velocity. Its graph is weighted from the distances kept per
+        // edge, and only what depends on the weights is redone: PARTITIONED
+        // keeps this router's partition and recomputes the cliques, the other
+        // precomputing engines precompute again. This router is left as it is,
+        // so queries on it can go on meanwhile.
+        std::unique_ptr<TransportRouter> WithTimeSettings(const TimeSettings& time_settings) const;
+        cache::CacheStats GetRouteCacheStats() const;
+        void ClearRouteCache() const;
+        memory::Usage GetMemoryUsage() const;
     
         private:
+        TransportRouter(const TransportRouter& base, const TimeSettings& time_settings);
+
+        // The graph and the engine built over it, for one weight type. The
+        // float all-pairs table of MINUTES becomes an exact integer one.
+        template <typename Weight>
+        struct Engines {
+            using EdgeWeight = Weight;
+            using DenseWeight = std::conditional_t<std::is_floating_point_v<Weight>, float, Weight>;
+
+            Engines(size_t vertex_count, std::pmr::memory_resource* resource)
+            :graph(vertex_count, resource){}
+
+            graph::DirectedWeightedGraph<Weight> graph;
+            std::unique_ptr<graph::Router<Weight>> router;
+            std::unique_ptr<graph::DenseRouter<Weight, DenseWeight>> dense_router;
+            std::unique_ptr<graph::Landmarks<Weight>> landmarks;
+            std::unique_ptr<graph::PartitionRouter<Weight>> partition_router;
+        };
+        using EngineVariant = std::variant<Engines<double>, Engines<FixedWeight>>;
+
+        static EngineVariant MakeEngines(const RoutingSettings& settings, size_t vertex_count, std::pmr::memory_resource* resource);
+        template <typename Weight>
+        std::optional<std::vector<graph::EdgeId>> BuildRoute(const Engines<Weight>& engines, graph::VertexId from, graph::VertexId to) const;
+        template <typename Weight>
+        std::optional<std::vector<graph::EdgeId>> BuildRoute(const Engines<Weight>& engines, graph::VertexId from, graph::VertexId to,
+                                                             const TimeSettings& time_settings) const;
+        template <typename Weight>
+        std::optional<std::vector<graph::EdgeId>> ExtractRoute(const graph::Dijkstra<Weight>& search, graph::VertexId to) const;
+        template <typename Weight>
+        ShortestPathTreePtr GetShortestPathTree(const Engines<Weight>& engines, graph::VertexId from) const;
+        template <typename Weight>
+        void ComputeTravelTimeRows(const Engines<Weight>& engines, const std::vector<const transport::Stop*>& sources,
+                                   const std::vector<graph::VertexId>& targets, TravelTimeMatrix& result) const;
+        // Search buffers for this router's graph, kept in a pool the router
+        // owns. A query takes a set for its duration and puts it back, so
+        // concurrent queries on a shared router neither lock nor do O(V) work
+        // to start a search once as many sets exist as queries run at once,
+        // whichever threads run them.
+        template <typename Weight>
+        struct SearchBuffers {
+            std::unique_ptr<graph::Dijkstra<Weight>> search;
+            std::unique_ptr<typename graph::PartitionRouter<Weight>::Search> partition;
+        };
+        struct SearchWorkspace {
+            std::tuple<SearchBuffers<double>, SearchBuffers<FixedWeight>> buffers;
+            std::unique_ptr<RaptorRouter::Search> raptor;
+        };
+        using WorkspaceLease = pool::ObjectPool<SearchWorkspace>::Lease;
+        template <typename Weight>
+        static graph::Dijkstra<Weight>& GetSearch(SearchWorkspace& workspace, const Engines<Weight>& engines);
+        void Preprocess();
+        template <typename Weight>
+        void Preprocess(Engines<Weight>& engines);
+        double ComputeEdgeWeight(int distance) const;
+        static double ComputeEdgeWeight(int distance, const TimeSettings& time_settings);
+        template <typename Weight>
+        static Weight ToWeight(double minutes);
+        template <typename Weight>
+        static double ToMinutes(Weight weight);
         void AddVertexes(const transport::TransportCatalogue& catalogue);
         void BuildGraph(const transport::TransportCatalogue& catalogue);
+        void AddEdge(std::string_view bus, int span_count, graph::VertexId from, graph::VertexId to, int distance);
         const transport::Stop* GetStop(graph::VertexId id) const;
 
         template <typename Iterator>
@@ -65,10 +269,20 @@ namespace router {
         }
         
         RoutingSettings settings_;
+        // The graph and the all-pairs tables are built once, on one thread,
+        // and freed together with the router.
+        std::pmr::unsynchronized_pool_resource arena_;
         std::vector<const transport::Stop*> stops_to_graph_;
         std::unordered_map<const transport::Stop*, graph::VertexId> vertexes_;
-        graph::DirectedWeightedGraph<double> graph_;
-        std::unique_ptr<graph::Router<double>> router_;  
+        // Holds the alternative matching settings_.weight_type.
+        EngineVariant engines_;
+        // Road distance of every edge, so weights can be recomputed or
+        // computed under other settings.
+        std::vector<int> edge_distances_;
+        mutable cache::LruCache<std::pair<graph::VertexId, graph::VertexId>, RouteEdgesPtr, VertexPairHasher> route_cache_;
+        mutable cache::LruCache<graph::VertexId, ShortestPathTreePtr> tree_cache_;
+        RaptorRouter raptor_;
+        pool::ObjectPool<SearchWorkspace> workspaces_;
     };
     
     